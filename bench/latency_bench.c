@@ -0,0 +1,470 @@
+/*
+Interactive latency benchmark for the prompt library.
+
+Every API runs in a child process whose stdin and stdout are a pty,
+created with forkpty, so no real terminal is needed. The parent plays
+the user. It types keystroke sequences at a controlled rate, types lines
+with trailing words, pastes huge lines, and sends bursts of Enter.
+
+The latency of a call is the time from the write that carries the final
+Enter to the moment the next message shows up on the master, which is
+what the user waits for. It covers parsing the line, clearing what is
+left of it from stdin (the trailing words and the paste), and printing
+the next message. In a burst all the lines are already waiting, so a
+sample is the time from one call returning to the next, as the child
+reports it through a pipe. Both sides use CLOCK_MONOTONIC.
+
+The pty is in non-canonical mode with echo off. In canonical mode the
+kernel caps a line at 4095 bytes, which would break the paste scenario.
+
+Usage: prompt_latency_bench [iterations] [keystroke_interval_us]
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __APPLE__
+#include <util.h>
+#else
+#include <pty.h>
+#endif
+
+#include "prompt.h"
+
+#define DEFAULT_ITERATIONS          200
+#define DEFAULT_INTERVAL_US         200
+#define PASTE_SIZE                  (64 * 1024)
+#define BURST_LINES                 32
+#define STR_SIZE                    1024
+#define MESSAGE_TIMEOUT_MS          5000
+
+typedef enum Api
+{
+    API_PROMPT_INT,
+    API_PROMPT_DOUBLE,
+    API_PROMPT_GETS,
+    API_PROMPT_GETLINE,
+    API_COUNT
+} Api;
+
+typedef enum Scenario
+{
+    SCENARIO_TYPING,
+    SCENARIO_TRAILING,
+    SCENARIO_PASTE,
+    SCENARIO_BURST,
+    SCENARIO_COUNT
+} Scenario;
+
+static const char *API_NAMES[API_COUNT] = {
+    "prompt %d", "prompt %lf", "prompt_gets", "prompt_getline"
+};
+
+static const char *API_LINES[API_COUNT] = {
+    "1234567", "3.14159265358979", "Samuel Martin", "Samuel Martin"
+};
+
+static const char *SCENARIO_NAMES[SCENARIO_COUNT] = {
+    "typing", "trailing", "paste", "burst"
+};
+
+// prompt stops at the space, so it has to clear these from stdin.
+static const char TRAILING[] = " and some trailing words";
+
+// Forward declarations.
+static void run_child(Api api, int report_fd);
+static void run_scenario(Api api, Scenario scenario, size_t iterations,
+                         long interval_us);
+static size_t send_typing(int master, const char *line, long interval_us,
+                          struct timespec *sent);
+static size_t send_trailing(int master, const char *line, struct timespec *sent);
+static size_t send_paste(int master, const char *line, struct timespec *sent);
+static size_t send_burst(int master, const char *line, struct timespec *sent);
+static void write_all(int fd, const char *data, size_t size);
+static void drain_output(int master);
+static bool wait_message(int master, struct timespec *shown);
+static void print_results(Api api, Scenario scenario, double *samples,
+                          size_t count);
+static int compare_doubles(const void *a, const void *b);
+static double elapsed_us(const struct timespec *start, const struct timespec *end);
+static void sleep_until(struct timespec *when, long interval_us);
+
+int main(int argc, char **argv)
+{
+    size_t iterations = (argc > 1) ? strtoul(argv[1], NULL, 10) : DEFAULT_ITERATIONS;
+    long interval_us = (argc > 2) ? strtol(argv[2], NULL, 10) : DEFAULT_INTERVAL_US;
+
+    if (iterations == 0 || interval_us < 0)
+    {
+        fprintf(stderr, "usage: %s [iterations] [keystroke_interval_us]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // The child may still be writing its last report when we close the pipe.
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("%-16s %-9s %8s %10s %10s %10s %10s\n", "api", "scenario",
+           "samples", "p50(us)", "p99(us)", "p999(us)", "max(us)");
+
+    for (int api = 0; api < API_COUNT; api++)
+    {
+        for (int scenario = 0; scenario < SCENARIO_COUNT; scenario++)
+        {
+            run_scenario((Api)api, (Scenario)scenario, iterations, interval_us);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+// Calls the API until the parent hangs up, reporting
+// the time every call returns.
+static void run_child(Api api, int report_fd)
+{
+    char str[STR_SIZE] = {0};
+    char *line = NULL;
+    int number = 0;
+    double real = 0.0;
+    int result = 0;
+
+    // stdout was set up by the parent before the fork. A program started
+    // on a terminal has it line buffered, so the message is flushed
+    // when the child starts reading stdin.
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    while (result != EOF)
+    {
+        switch (api)
+        {
+            case API_PROMPT_INT:
+                result = prompt("> ", "%d", &number);
+                break;
+            case API_PROMPT_DOUBLE:
+                result = prompt("> ", "%lf", &real);
+                break;
+            case API_PROMPT_GETS:
+                result = prompt_gets("> ", str, sizeof(str));
+                break;
+            case API_PROMPT_GETLINE:
+                result = prompt_getline("> ", &line);
+                free(line);
+                line = NULL;
+                break;
+            case API_COUNT:
+                result = EOF;
+                break;
+        }
+
+        struct timespec done;
+        clock_gettime(CLOCK_MONOTONIC, &done);
+
+        if (write(report_fd, &done, sizeof(done)) != sizeof(done))
+        {
+            break;
+        }
+    }
+
+    _exit(EXIT_SUCCESS);
+}
+
+static void run_scenario(Api api, Scenario scenario, size_t iterations,
+                         long interval_us)
+{
+    int report[2];
+
+    if (pipe(report) == -1)
+    {
+        perror("pipe");
+        exit(EXIT_FAILURE);
+    }
+
+    struct termios termios;
+    memset(&termios, 0, sizeof(termios));
+    cfmakeraw(&termios);
+    termios.c_cc[VMIN] = 1;
+    termios.c_cc[VTIME] = 0;
+
+    // Nothing buffered may be inherited by the child.
+    fflush(stdout);
+
+    int master = -1;
+    pid_t pid = forkpty(&master, NULL, &termios, NULL);
+
+    if (pid == -1)
+    {
+        perror("forkpty");
+        exit(EXIT_FAILURE);
+    }
+
+    if (pid == 0)
+    {
+        close(report[0]);
+        run_child(api, report[1]);
+    }
+
+    close(report[1]);
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+    // The first message is not timed, it only has to be out of the way.
+    struct timespec shown;
+
+    if (!(wait_message(master, &shown)))
+    {
+        fprintf(stderr, "%s: child never prompted\n", API_NAMES[api]);
+        exit(EXIT_FAILURE);
+    }
+
+    size_t rounds = (scenario == SCENARIO_BURST)
+                    ? (iterations + BURST_LINES - 1) / BURST_LINES
+                    : iterations;
+    double *samples = malloc(sizeof(double) * rounds * BURST_LINES);
+    size_t count = 0;
+
+    if (samples == NULL)
+    {
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < rounds; i++)
+    {
+        struct timespec sent;
+        size_t calls = 0;
+
+        switch (scenario)
+        {
+            case SCENARIO_TYPING:
+                calls = send_typing(master, API_LINES[api], interval_us, &sent);
+                break;
+            case SCENARIO_TRAILING:
+                calls = send_trailing(master, API_LINES[api], &sent);
+                break;
+            case SCENARIO_PASTE:
+                calls = send_paste(master, API_LINES[api], &sent);
+                break;
+            case SCENARIO_BURST:
+                calls = send_burst(master, API_LINES[api], &sent);
+                break;
+            case SCENARIO_COUNT:
+                break;
+        }
+
+        // The next message is printed after the report is written,
+        // so once it shows up the report is already in the pipe.
+        if (scenario != SCENARIO_BURST && !(wait_message(master, &shown)))
+        {
+            fprintf(stderr, "%s: child stopped prompting\n", API_NAMES[api]);
+            exit(EXIT_FAILURE);
+        }
+
+        struct timespec previous = sent;
+
+        for (size_t j = 0; j < calls; j++)
+        {
+            struct timespec done;
+
+            if (read(report[0], &done, sizeof(done)) != sizeof(done))
+            {
+                fprintf(stderr, "%s: child stopped reporting\n", API_NAMES[api]);
+                exit(EXIT_FAILURE);
+            }
+
+            // A burst call waits for the calls before it, so only
+            // the time since the previous one returned is its own.
+            samples[count] = (scenario == SCENARIO_BURST)
+                             ? elapsed_us(&previous, &done)
+                             : elapsed_us(&sent, &shown);
+            previous = done;
+            count++;
+        }
+
+        drain_output(master);
+    }
+
+    // Hanging up makes the child read EOF and exit.
+    close(master);
+    waitpid(pid, NULL, 0);
+    close(report[0]);
+
+    print_results(api, scenario, samples, count);
+    free(samples);
+}
+
+// Types the line one keystroke at a time, then presses Enter.
+static size_t send_typing(int master, const char *line, long interval_us,
+                          struct timespec *sent)
+{
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    for (size_t i = 0; line[i] != '\0'; i++)
+    {
+        write_all(master, &line[i], 1);
+        sleep_until(&next, interval_us);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, sent);
+    write_all(master, "\n", 1);
+
+    return 1;
+}
+
+// Sends the line with words after it in a single write.
+static size_t send_trailing(int master, const char *line, struct timespec *sent)
+{
+    char trailing[STR_SIZE];
+    int length = snprintf(trailing, sizeof(trailing), "%s%s\n", line, TRAILING);
+
+    clock_gettime(CLOCK_MONOTONIC, sent);
+    write_all(master, trailing, (size_t)length);
+
+    return 1;
+}
+
+// Pastes a huge line of the line repeated, in a single write. The line is
+// longer than any buffer the child uses, so prompt_gets measures the
+// truncation path, and prompt, which stops at the first space, has to
+// clear almost all of it from stdin.
+static size_t send_paste(int master, const char *line, struct timespec *sent)
+{
+    static char paste[PASTE_SIZE + 1];
+    size_t length = strlen(line) + 1;
+
+    for (size_t i = 0; i < PASTE_SIZE; i++)
+    {
+        paste[i] = (i % length == length - 1) ? ' ' : line[i % length];
+    }
+
+    paste[PASTE_SIZE] = '\n';
+
+    clock_gettime(CLOCK_MONOTONIC, sent);
+    write_all(master, paste, sizeof(paste));
+
+    return 1;
+}
+
+// Sends BURST_LINES lines at once, as if Enter was held down.
+static size_t send_burst(int master, const char *line, struct timespec *sent)
+{
+    static char burst[BURST_LINES * (STR_SIZE + 1)];
+    size_t length = strlen(line);
+    size_t size = 0;
+
+    for (size_t i = 0; i < BURST_LINES; i++)
+    {
+        memcpy(&burst[size], line, length);
+        size += length;
+        burst[size] = '\n';
+        size++;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, sent);
+    write_all(master, burst, size);
+
+    return BURST_LINES;
+}
+
+// The master is non-blocking, so the child's prompt messages
+// have to be drained while we wait for it to catch up.
+static void write_all(int fd, const char *data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t written = write(fd, data, size);
+
+        if (written == -1)
+        {
+            if (errno != EAGAIN && errno != EINTR)
+            {
+                perror("write");
+                exit(EXIT_FAILURE);
+            }
+
+            drain_output(fd);
+            continue;
+        }
+
+        data += written;
+        size -= (size_t)written;
+    }
+}
+
+static void drain_output(int master)
+{
+    char discard[4096];
+
+    while (read(master, discard, sizeof(discard)) > 0)
+    {
+    }
+}
+
+// Waits for the child's next message and returns when it showed up.
+static bool wait_message(int master, struct timespec *shown)
+{
+    struct pollfd pollfd = {master, POLLIN, 0};
+
+    if (poll(&pollfd, 1, MESSAGE_TIMEOUT_MS) != 1)
+    {
+        return false;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, shown);
+    drain_output(master);
+
+    return true;
+}
+
+static void print_results(Api api, Scenario scenario, double *samples,
+                          size_t count)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    qsort(samples, count, sizeof(double), compare_doubles);
+
+    printf("%-16s %-9s %8zu %10.1f %10.1f %10.1f %10.1f\n",
+           API_NAMES[api], SCENARIO_NAMES[scenario], count,
+           samples[(count - 1) * 50 / 100],
+           samples[(count - 1) * 99 / 100],
+           samples[(count - 1) * 999 / 1000],
+           samples[count - 1]);
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+
+    return (x > y) - (x < y);
+}
+
+static double elapsed_us(const struct timespec *start, const struct timespec *end)
+{
+    return (double)(end->tv_sec - start->tv_sec) * 1e6
+           + (double)(end->tv_nsec - start->tv_nsec) / 1e3;
+}
+
+// Sleeps to an absolute time, so the typing rate does not drift.
+static void sleep_until(struct timespec *when, long interval_us)
+{
+    when->tv_nsec += interval_us * 1000L;
+
+    while (when->tv_nsec >= 1000000000L)
+    {
+        when->tv_sec++;
+        when->tv_nsec -= 1000000000L;
+    }
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, when, NULL) == EINTR)
+    {
+    }
+}
@@ -0,0 +1,236 @@
+/*
+Replays a log made with prompt_record_start.
+
+prompt_replay_bench --record <log>
+    Reads stdin line by line with prompt_gets until EOF and records it.
+
+prompt_replay_bench <log> [iterations]
+    Parses the log with prompt_gets_stream as fast as possible
+    and prints the cost per byte.
+
+prompt_replay_bench --pipe [--realtime] <log>
+    Writes the log to stdout, at its original timing with --realtime,
+    so it can be piped into any program that uses prompt.
+
+prompt_replay_bench --check
+    Records a file with invalid UTF-8 in it while reading it in UTF-8 mode,
+    and fails unless the replay gives back exactly the same bytes.
+*/
+
+#define _POSIX_C_SOURCE             200809L
+
+#include <time.h>
+#include <unistd.h>
+
+#include "prompt.h"
+
+#define DEFAULT_ITERATIONS          10
+#define LINE_SIZE                   1024
+
+// A lead byte followed by ASCII, a stray continuation byte, and multi-byte
+// delims. The small buffer makes the reads truncate too.
+static const char CHECK_INPUT[] = "plain ascii line\n"
+                                  "x\xE3y\n"
+                                  "\x80stray\n"
+                                  "h\xC3\xA9llo\xE3\x80\x81world\n"
+                                  "no newline at the end";
+#define CHECK_BUFFER_SIZE           6
+
+// Forward declarations.
+static int record(const char *path);
+static int parse(const char *path, size_t iterations);
+static int pipe_log(const char *path, bool realtime);
+static int check(void);
+static double elapsed_ns(const struct timespec *start, const struct timespec *end);
+
+int main(int argc, char **argv)
+{
+    if (argc == 2 && !(strcmp(argv[1], "--check")))
+    {
+        return check();
+    }
+
+    if (argc == 3 && !(strcmp(argv[1], "--record")))
+    {
+        return record(argv[2]);
+    }
+
+    if (argc == 3 && !(strcmp(argv[1], "--pipe")))
+    {
+        return pipe_log(argv[2], false);
+    }
+
+    if (argc == 4 && !(strcmp(argv[1], "--pipe")) && !(strcmp(argv[2], "--realtime")))
+    {
+        return pipe_log(argv[3], true);
+    }
+
+    size_t iterations = (argc == 3) ? strtoul(argv[2], NULL, 10) : DEFAULT_ITERATIONS;
+
+    if ((argc == 2 || argc == 3) && iterations != 0)
+    {
+        return parse(argv[1], iterations);
+    }
+
+    fprintf(stderr, "usage: %s --record <log>\n"
+                    "       %s <log> [iterations]\n"
+                    "       %s --pipe [--realtime] <log>\n"
+                    "       %s --check\n", argv[0], argv[0], argv[0], argv[0]);
+
+    return EXIT_FAILURE;
+}
+
+static int record(const char *path)
+{
+    char line[LINE_SIZE] = {0};
+
+    if (!(prompt_record_start(stdin, path)))
+    {
+        fprintf(stderr, "could not record to %s\n", path);
+        return EXIT_FAILURE;
+    }
+
+    while (prompt_gets("", line, sizeof(line)) == 1)
+    {
+    }
+
+    prompt_record_stop();
+
+    return EXIT_SUCCESS;
+}
+
+static int parse(const char *path, size_t iterations)
+{
+    char line[LINE_SIZE] = {0};
+    size_t lines = 0;
+    size_t bytes = 0;
+    double ns = 0.0;
+
+    for (size_t i = 0; i < iterations; i++)
+    {
+        FILE *replay = prompt_replay_open(path, false);
+
+        if (replay == NULL)
+        {
+            fprintf(stderr, "could not replay %s\n", path);
+            return EXIT_FAILURE;
+        }
+
+        struct timespec start;
+        struct timespec end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        while (prompt_gets_stream(line, sizeof(line), replay) == 1)
+        {
+            lines++;
+            bytes += strlen(line) + 1;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        ns += elapsed_ns(&start, &end);
+
+        fclose(replay);
+    }
+
+    printf("%zu lines, %zu bytes, %.2f ns/byte\n", lines / iterations,
+           bytes / iterations, (bytes != 0) ? ns / (double)bytes : 0.0);
+
+    return EXIT_SUCCESS;
+}
+
+static int pipe_log(const char *path, bool realtime)
+{
+    FILE *replay = prompt_replay_open(path, realtime);
+
+    if (replay == NULL)
+    {
+        fprintf(stderr, "could not replay %s\n", path);
+        return EXIT_FAILURE;
+    }
+
+    // Line buffered, so the reader gets every line at its original time.
+    // fread would wait for a whole buffer instead.
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    int ch = getc(replay);
+
+    while (ch != EOF)
+    {
+        putchar(ch);
+        ch = getc(replay);
+    }
+
+    fclose(replay);
+
+    return EXIT_SUCCESS;
+}
+
+static int check(void)
+{
+    char input_path[] = "/tmp/prompt_replay_input_XXXXXX";
+    char log_path[] = "/tmp/prompt_replay_log_XXXXXX";
+    int input_fd = mkstemp(input_path);
+    int log_fd = mkstemp(log_path);
+
+    if (input_fd == -1 || log_fd == -1)
+    {
+        perror("mkstemp");
+        return EXIT_FAILURE;
+    }
+
+    // The log is appended to, so it starts empty.
+    close(log_fd);
+
+    const size_t INPUT_SIZE = sizeof(CHECK_INPUT) - 1;
+    bool ok = write(input_fd, CHECK_INPUT, INPUT_SIZE) == (ssize_t)INPUT_SIZE;
+    close(input_fd);
+
+    FILE *input = ok ? fopen(input_path, "r") : NULL;
+    ok = input != NULL && prompt_record_start(input, log_path);
+
+    if (ok)
+    {
+        char line[CHECK_BUFFER_SIZE];
+
+        while (prompt_gets_delim_stream_utf8(line, sizeof(line), "\xE3\x80\x81\n",
+                                             true, input) != EOF)
+        {
+        }
+
+        prompt_record_stop();
+    }
+
+    if (input != NULL)
+    {
+        fclose(input);
+    }
+
+    FILE *replay = ok ? prompt_replay_open(log_path, false) : NULL;
+    char replayed[sizeof(CHECK_INPUT)] = {0};
+    size_t length = 0;
+
+    if (replay != NULL)
+    {
+        length = fread(replayed, 1, sizeof(replayed), replay);
+        fclose(replay);
+    }
+
+    unlink(input_path);
+    unlink(log_path);
+
+    if (replay == NULL || length != INPUT_SIZE || memcmp(replayed, CHECK_INPUT, length) != 0)
+    {
+        fprintf(stderr, "the replay does not match the recorded input\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("replay matches the %zu recorded bytes\n", length);
+
+    return EXIT_SUCCESS;
+}
+
+static double elapsed_ns(const struct timespec *start, const struct timespec *end)
+{
+    return (double)(end->tv_sec - start->tv_sec) * 1e9
+           + (double)(end->tv_nsec - start->tv_nsec);
+}
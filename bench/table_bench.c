@@ -0,0 +1,282 @@
+/*
+Benchmark for prompt_table_load and its cache.
+
+Writes a text file of rows like "12 3.25 -0.5" and loads it with the
+format "%d%lf%lf": first without the cache, then while writing the
+cache, then from the cache, which has to be mapped and writable.
+Then it corrupts the cache and touches
+the text file, and checks that both loads fall back to the text.
+Last, it rewrites the text file just now and checks that it is not
+cached, since it could still change without its mtime showing it, and
+checks that a file that fails to read (a directory) is neither loaded
+nor cached.
+Every load is compared against the first one.
+
+Usage: prompt_table_bench [rows]
+*/
+
+#define _POSIX_C_SOURCE             200809L
+
+#include <fcntl.h>
+#include <glob.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "prompt.h"
+
+#define DEFAULT_ROWS                1000000
+#define FORMAT                      "%d%lf%lf"
+
+// A text file written just now is not cached, so the text
+// is dated back by these many seconds.
+#define FIRST_AGE                   60
+#define SECOND_AGE                  30
+
+// Forward declarations.
+static bool write_text(const char *path, size_t rows, time_t age);
+static bool load(const char *name, const char *path, bool use_cache,
+                 const PromptTable *expected, PromptTable *table);
+static bool is_same_table(const PromptTable *a, const PromptTable *b);
+static bool is_writable_mapping(const PromptTable *table);
+static bool is_not_mapped(const PromptTable *table);
+static bool is_read_error_rejected(void);
+static bool corrupt_cache(const char *path);
+static void remove_caches(const char *path);
+static double elapsed_ms(const struct timespec *start, const struct timespec *end);
+
+int main(int argc, char **argv)
+{
+    size_t rows = (argc > 1) ? strtoul(argv[1], NULL, 10) : DEFAULT_ROWS;
+    char path[] = "/tmp/prompt_table_bench_XXXXXX";
+    int fd = mkstemp(path);
+
+    if (rows == 0 || fd == -1)
+    {
+        fprintf(stderr, "usage: %s [rows]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    close(fd);
+
+    PromptTable text;
+    PromptTable table;
+    bool ok = write_text(path, rows, FIRST_AGE)
+              && load("text", path, false, NULL, &text)
+              && load("text + write cache", path, true, &text, &table);
+
+    prompt_table_free(&table);
+    ok = ok && load("cache", path, true, &text, &table)
+         && is_writable_mapping(&table);
+    prompt_table_free(&table);
+
+    // The write above must not have reached the cache.
+    ok = ok && load("cache after write", path, true, &text, &table);
+    prompt_table_free(&table);
+
+    ok = ok && corrupt_cache(path)
+         && load("corrupt cache", path, true, &text, &table);
+    prompt_table_free(&table);
+
+    // Rewriting the text with the same values changes its mtime.
+    ok = ok && write_text(path, rows, SECOND_AGE)
+         && load("stale cache", path, true, &text, &table);
+    prompt_table_free(&table);
+
+    ok = ok && write_text(path, rows, 0)
+         && load("racy text", path, true, &text, &table);
+    prompt_table_free(&table);
+
+    ok = ok && load("racy text again", path, true, &text, &table)
+         && is_not_mapped(&table);
+    prompt_table_free(&table);
+
+    ok = ok && is_read_error_rejected();
+
+    prompt_table_free(&text);
+    remove_caches(path);
+    unlink(path);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// The mtime of the text is set age seconds in the past.
+static bool write_text(const char *path, size_t rows, time_t age)
+{
+    FILE *text = fopen(path, "w");
+
+    if (text == NULL)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < rows; i++)
+    {
+        fprintf(text, "%zu %.17g %.17g\n", i, (double)i / 7.0, -(double)i * 1e-3);
+    }
+
+    if (fclose(text) != 0)
+    {
+        return false;
+    }
+
+    struct timespec times[2];
+    clock_gettime(CLOCK_REALTIME, &times[0]);
+    times[0].tv_sec -= age;
+    times[1] = times[0];
+
+    return age == 0 || utimensat(AT_FDCWD, path, times, 0) == 0;
+}
+
+static bool load(const char *name, const char *path, bool use_cache,
+                 const PromptTable *expected, PromptTable *table)
+{
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (!(prompt_table_load(path, FORMAT, use_cache, table)))
+    {
+        fprintf(stderr, "%s: load failed\n", name);
+        return false;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("%-20s %10zu rows %10.2f ms %s\n", name, table->rows,
+           elapsed_ms(&start, &end), table->mapping ? "(mapped)" : "");
+
+    if (expected != NULL && !(is_same_table(expected, table)))
+    {
+        fprintf(stderr, "%s: values differ from the text\n", name);
+        return false;
+    }
+
+    return true;
+}
+
+static bool is_same_table(const PromptTable *a, const PromptTable *b)
+{
+    if (a->rows != b->rows || a->columns != b->columns)
+    {
+        return false;
+    }
+
+    return !(memcmp(a->data[0], b->data[0], a->rows * sizeof(int)))
+           && !(memcmp(a->data[1], b->data[1], a->rows * sizeof(double)))
+           && !(memcmp(a->data[2], b->data[2], a->rows * sizeof(double)));
+}
+
+static bool is_writable_mapping(const PromptTable *table)
+{
+    if (table->mapping == NULL)
+    {
+        fprintf(stderr, "cache: not loaded from the cache\n");
+        return false;
+    }
+
+    int *ids = table->data[0];
+    ids[0] = 42;
+
+    return ids[0] == 42;
+}
+
+static bool is_not_mapped(const PromptTable *table)
+{
+    if (table->mapping != NULL)
+    {
+        fprintf(stderr, "racy text: a cache was written for it\n");
+        return false;
+    }
+
+    return true;
+}
+
+// Reading a directory fails with EISDIR after it opens fine.
+static bool is_read_error_rejected(void)
+{
+    char path[] = "/tmp/prompt_table_bench_dir_XXXXXX";
+    PromptTable table;
+
+    if (mkdtemp(path) == NULL)
+    {
+        return false;
+    }
+
+    // Old enough to be cached, if it were ever read.
+    struct timespec times[2];
+    clock_gettime(CLOCK_REALTIME, &times[0]);
+    times[0].tv_sec -= FIRST_AGE;
+    times[1] = times[0];
+    utimensat(AT_FDCWD, path, times, 0);
+
+    bool loaded = prompt_table_load(path, FORMAT, true, &table);
+
+    if (loaded)
+    {
+        prompt_table_free(&table);
+        fprintf(stderr, "read error: a directory loaded as a table\n");
+    }
+
+    remove_caches(path);
+    rmdir(path);
+
+    return !loaded;
+}
+
+// Flips a byte in the middle of the cache of path.
+static bool corrupt_cache(const char *path)
+{
+    char pattern[128];
+    glob_t caches;
+
+    snprintf(pattern, sizeof(pattern), "%s.*.pcache", path);
+
+    if (glob(pattern, 0, NULL, &caches) != 0)
+    {
+        return false;
+    }
+
+    FILE *file = fopen(caches.gl_pathv[0], "r+b");
+    globfree(&caches);
+
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    fseek(file, ftell(file) / 2, SEEK_SET);
+
+    int byte = fgetc(file);
+    fseek(file, -1, SEEK_CUR);
+    fputc(byte ^ 0xFF, file);
+
+    return fclose(file) == 0;
+}
+
+// The cache is named after the text file and the format.
+static void remove_caches(const char *path)
+{
+    char pattern[128];
+    glob_t caches;
+
+    snprintf(pattern, sizeof(pattern), "%s.*.pcache", path);
+
+    if (glob(pattern, 0, NULL, &caches) != 0)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < caches.gl_pathc; i++)
+    {
+        unlink(caches.gl_pathv[i]);
+    }
+
+    globfree(&caches);
+}
+
+static double elapsed_ms(const struct timespec *start, const struct timespec *end)
+{
+    return (double)(end->tv_sec - start->tv_sec) * 1e3
+           + (double)(end->tv_nsec - start->tv_nsec) / 1e6;
+}
@@ -0,0 +1,187 @@
+/*
+Multi-threaded throughput benchmark for the prompt library.
+
+Each run reads the same text with prompt_gets_stream from 1, 2, 4,
+and 8 threads, first with a stream per thread and then with one shared
+stream. It prints the cost per byte each thread sees and the total
+throughput. Independent streams should scale, a shared stream should not.
+
+Every line read is checked against the input, so a torn or lost line
+(two threads interleaving inside one read) makes the run fail.
+
+Usage: prompt_thread_bench [lines]
+*/
+
+#define _POSIX_C_SOURCE             200809L
+
+#include <pthread.h>
+#include <time.h>
+
+#include "prompt.h"
+
+#define DEFAULT_LINES               200000
+#define MAX_THREADS                 8
+#define LINE_SIZE                   64
+
+static const char LINE[] = "3.14159265358979 Samuel Martin 1234567 -42";
+
+typedef struct Worker
+{
+    pthread_t thread;
+    FILE *stream;
+    size_t lines;
+    size_t bytes;
+    bool corrupt;
+} Worker;
+
+// Forward declarations.
+static void *read_stream(void *arg);
+static char *make_text(size_t lines, size_t *size);
+static bool run(const char *text, size_t size, size_t lines, int threads,
+                bool shared);
+static double elapsed_ns(const struct timespec *start, const struct timespec *end);
+
+int main(int argc, char **argv)
+{
+    size_t lines = (argc > 1) ? strtoul(argv[1], NULL, 10) : DEFAULT_LINES;
+    size_t size = 0;
+    char *text = make_text(lines, &size);
+
+    if (lines == 0 || text == NULL)
+    {
+        fprintf(stderr, "usage: %s [lines]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    bool ok = true;
+
+    printf("%-12s %8s %14s %12s\n", "streams", "threads", "ns/byte/thread", "total MB/s");
+
+    for (int shared = 0; shared <= 1; shared++)
+    {
+        for (int threads = 1; threads <= MAX_THREADS; threads *= 2)
+        {
+            ok &= run(text, size, lines, threads, shared);
+        }
+    }
+
+    free(text);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static void *read_stream(void *arg)
+{
+    Worker *worker = arg;
+    char line[LINE_SIZE] = {0};
+
+    while (prompt_gets_stream(line, sizeof(line), worker->stream) == 1)
+    {
+        // The last call reads only the EOF.
+        if (line[0] == '\0')
+        {
+            continue;
+        }
+
+        if (strcmp(line, LINE) != 0)
+        {
+            worker->corrupt = true;
+        }
+
+        worker->lines++;
+        worker->bytes += sizeof(LINE);
+    }
+
+    return NULL;
+}
+
+static char *make_text(size_t lines, size_t *size)
+{
+    *size = lines * sizeof(LINE);
+    char *text = malloc(*size);
+
+    if (text == NULL)
+    {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < lines; i++)
+    {
+        memcpy(&text[i * sizeof(LINE)], LINE, sizeof(LINE) - 1);
+        text[(i + 1) * sizeof(LINE) - 1] = '\n';
+    }
+
+    return text;
+}
+
+// Each thread reads all of the text from its own stream, or all
+// threads split one copy of the text between them.
+static bool run(const char *text, size_t size, size_t lines, int threads,
+                bool shared)
+{
+    Worker workers[MAX_THREADS];
+    FILE *shared_stream = shared ? fmemopen((void*)text, size, "r") : NULL;
+
+    for (int i = 0; i < threads; i++)
+    {
+        workers[i] = (Worker){0};
+        workers[i].stream = shared ? shared_stream : fmemopen((void*)text, size, "r");
+
+        if (workers[i].stream == NULL)
+        {
+            perror("fmemopen");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (int i = 0; i < threads; i++)
+    {
+        pthread_create(&workers[i].thread, NULL, read_stream, &workers[i]);
+    }
+
+    size_t total_lines = 0;
+    size_t total_bytes = 0;
+    bool corrupt = false;
+
+    for (int i = 0; i < threads; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+        total_lines += workers[i].lines;
+        total_bytes += workers[i].bytes;
+        corrupt |= workers[i].corrupt;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    // A shared stream is only closed once.
+    for (int i = 0; i < (shared ? 1 : threads); i++)
+    {
+        fclose(workers[i].stream);
+    }
+
+    double ns = elapsed_ns(&start, &end);
+    size_t expected = shared ? lines : lines * (size_t)threads;
+
+    printf("%-12s %8d %14.2f %12.1f\n", shared ? "shared" : "independent",
+           threads, ns * threads / (double)total_bytes,
+           (double)total_bytes / ns * 1e3);
+
+    if (corrupt || total_lines != expected)
+    {
+        fprintf(stderr, "read %zu of %zu lines%s\n", total_lines, expected,
+                corrupt ? ", some of them torn" : "");
+        return false;
+    }
+
+    return true;
+}
+
+static double elapsed_ns(const struct timespec *start, const struct timespec *end)
+{
+    return (double)(end->tv_sec - start->tv_sec) * 1e9
+           + (double)(end->tv_nsec - start->tv_nsec);
+}
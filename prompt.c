@@ -1,5 +1,29 @@
+// For poll, fileno, clock_gettime, and the
+// custom streams (fopencookie or funopen) used by replay.
+#define _GNU_SOURCE
+#define _DARWIN_C_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
 #include "prompt.h"
 
+// The _timeout functions need to know if a stream still has chars in its
+// buffer, or they would wait on the fd for chars that were already read.
+// Where we cannot look into a FILE's buffer, they are not supported.
+#if defined(__GLIBC__) || defined(__APPLE__) || defined(__FreeBSD__) \
+    || defined(__NetBSD__) || defined(__OpenBSD__)
+#define BUFFER_VISIBLE              true
+#else
+#define BUFFER_VISIBLE              false
+#endif
+
 // USHRT_MAX and UINT32_MAX could be unsigned,
 // so I need to typecast them.
 // I wanted to check when the user goes below the min limit.
@@ -14,7 +38,7 @@
 // How I determined MAX_READ.
 // https://stackoverflow.com/questions/1701055/
 // what-is-the-maximum-length-in-chars-needed-to-represent-any-double-value
-#define MAX_READ                    1080
+#define MAX_READ                    PROMPT_MAX_READ
 
 #define MAX_FORMAT                  2
 
@@ -27,22 +51,141 @@
 #define READ_FAILURE                (1 << 1)
 #define READ_SUCCESS                (1 << 2)
 #define READ_NON_NUMERIC            (1 << 3)
+#define READ_TIMEOUT                (1 << 4)
+
+// The log starts with LOG_MAGIC, followed by records. Every record
+// is a tag, the microseconds since the previous record as a varint,
+// and a varint. For LOG_DATA the varint is the number of chars
+// that follow, for LOG_CLEARED it is the number of chars that were
+// cleared from the input buffer (they are also in the LOG_DATA records),
+// and for LOG_SESSION it is the wall clock time in seconds.
+#define LOG_MAGIC                   "PROMPTL1"
+#define LOG_MAGIC_SIZE              8
+#define LOG_SESSION                 'S'
+#define LOG_DATA                    'D'
+#define LOG_CLEARED                 'C'
+#define LOG_CHUNK                   256
+
+// The cache for a table sits next to the text file, with the hash of
+// the format in its name so every format gets its own cache.
+// It is a CacheHeader, the format, and then every column one after
+// the other. Everything is padded to CACHE_ALIGN, so the columns can
+// be used straight from the mapping.
+#define CACHE_MAGIC                 "PROMPTC2"
+#define CACHE_MAGIC_SIZE            8
+#define CACHE_SUFFIX                ".pcache"
+#define CACHE_ALIGN                 8
+#define CACHE_PADDED(size)          (((size) + CACHE_ALIGN - 1) & ~(size_t)(CACHE_ALIGN - 1))
+
+// A text file modified this recently is not cached. Some file systems
+// only keep the mtime to the second (FAT to two seconds), so the file
+// could still change without changing its size or mtime, and the cache
+// would then look fresh. This is the same rule git uses for racy files.
+#define CACHE_RACY_SECONDS          2
+
+#if defined(__APPLE__)
+#define MTIME_NSEC(st)              ((st).st_mtimespec.tv_nsec)
+#else
+#define MTIME_NSEC(st)              ((st).st_mtim.tv_nsec)
+#endif
+
+// A NULL Deadline means wait forever.
+typedef struct Deadline
+{
+    struct timespec end;
+} Deadline;
 
 typedef struct ArgumentType
 {
     int status;
     int options;
+    const Deadline *deadline;
+    PromptResume *resume;
+    size_t resumed;
     void *(*get)(va_list *args);
     void (*set)(void *arg, const char *str);
 } ArgumentType;
 
 typedef void (*ArgumentParser)(ArgumentType *arg_type, va_list *args);
 
+// Only touched while holding the lock on the recorded stream.
+typedef struct Recorder
+{
+    FILE *log;
+    struct timespec last;
+    struct timespec arrived;
+    size_t length;
+    char chunk[LOG_CHUNK];
+} Recorder;
+
+typedef struct Replay
+{
+    unsigned char *log;
+    size_t size;
+    size_t position;
+    const unsigned char *data;
+    size_t remaining;
+    bool original_timing;
+    struct timespec next;
+} Replay;
+
+typedef struct ColumnType
+{
+    const char *specifier;
+    size_t size;
+    void (*set)(void *arg, const char *str);
+} ColumnType;
+
+typedef struct CacheHeader
+{
+    char magic[CACHE_MAGIC_SIZE];
+    uint64_t source_dev;
+    uint64_t source_ino;
+    uint64_t source_size;
+    int64_t source_mtime;
+    int64_t source_mtime_nsec;
+    uint64_t rows;
+    uint64_t columns;
+    uint64_t format_size;
+    uint64_t checksum;
+} CacheHeader;
+
+// The stream being recorded. It is checked for every char,
+// so it is atomic instead of behind a lock.
+static _Atomic(FILE*) recorded_stream = NULL;
+static Recorder recorder;
+
 // Forward declarations.
+static int parse_getline(char **input, const char *delim, bool matched_delim,
+                         FILE *stream, const Deadline *deadline);
+static int vprompt(const char *format, const Deadline *deadline,
+                   PromptResume *resume, va_list *args);
+static int record_char(FILE *stream);
+static void record_chunk(void);
+static void record_cleared(FILE *stream, size_t count);
+static void write_record(int tag, uint64_t value, const struct timespec *when);
+static void write_varint(FILE *log, uint64_t value);
+static bool read_varint(Replay *replay, uint64_t *value);
+static bool next_record(Replay *replay);
+static size_t replay_read(Replay *replay, char *buffer, size_t size);
+static FILE *replay_stream(Replay *replay);
+static const ColumnType **parse_columns(const char *format, size_t *columns);
+static char *cache_path(const char *path, const char *format);
+static bool load_cache(const char *path, const struct stat *source,
+                       const char *format, const ColumnType **types,
+                       size_t columns, PromptTable *table);
+static bool parse_table(const char *path, const ColumnType **types,
+                        size_t columns, PromptTable *table);
+static void write_cache(const char *path, const struct stat *source,
+                        const char *format, const ColumnType **types,
+                        const PromptTable *table);
+static bool is_same_file(const struct stat *a, const struct stat *b);
+static uint64_t checksum(const void *data, size_t size);
 static char *str_alloc(const char *s);
 static char *strsep_chars(char **data, const char *separator);
 static int parse_format(va_list *args, const char *specifier,
-                        bool multple_specifiers, int *successfully_read);
+                        bool multple_specifiers, const Deadline *deadline,
+                        PromptResume *resume, int *successfully_read);
 static void parse_types(ArgumentType *arg_type, va_list *args);
 static void *va_arg_char(va_list *args);
 static void parse_char(void *arg, const char *str);
@@ -63,68 +206,119 @@ static void parse_ulong(void *arg, const char *str);
 static void *va_arg_uint(va_list *args);
 static void parse_uint(void *arg, const char *str);
 static void parse_str(ArgumentType *arg_type, va_list *args);
-static void parse_prompt(char *input, const size_t BUFFER_SIZE, ArgumentType *arg_type,
-                         const char *delim, bool matched_delim, FILE *stream);
+static int parse_gets(char *input, const size_t BUFFER_SIZE, const char *delim,
+                      bool matched_delim, FILE *stream, int timeout_ms, bool utf8);
+static int parse_prompt(char *input, const size_t BUFFER_SIZE, ArgumentType *arg_type,
+                        const char *delim, bool matched_delim, FILE *stream,
+                        const Deadline *deadline, bool *invalid_utf8);
+static int clear_input(FILE *stream, int ch, const Deadline *deadline);
 static bool is_multiple_specifiers(ArgumentType *arg_type, int ch);
 static bool is_strchr(const char *s, int ch);
 static bool is_space(ArgumentType *arg_type, int ch);
 static bool is_non_numeric(ArgumentType *arg_type, int ch);
 static size_t calculate_capacity(size_t capacity);
+static bool is_timeout_supported(int timeout_ms);
+static const Deadline *deadline_init(Deadline *deadline, int timeout_ms);
+static int deadline_remaining(const Deadline *deadline);
+static int read_char(FILE *stream, const Deadline *deadline);
+static void unread_char(int ch, FILE *stream);
+static bool is_buffered(FILE *stream);
+static bool wait_readable(FILE *stream, const Deadline *deadline);
+static size_t read_code_point(char *code_point, int ch, FILE *stream,
+                              const Deadline *deadline);
+static size_t utf8_length(unsigned char lead);
+static bool is_strseq(const char *s, const char *code_point, size_t length);
+static bool is_utf8(const char *str, size_t length);
+static size_t code_point_length(const unsigned char *s, size_t length);
+
+// The specifiers a table column can have. %s is not
+// supported, a column has to have a fixed size.
+static const ColumnType COLUMN_TYPES[] = {
+    {"c", sizeof(char), parse_char},
+    {"d", sizeof(int), parse_int},
+    {"f", sizeof(float), parse_float},
+    {"hi", sizeof(short), parse_short},
+    {"hu", sizeof(unsigned short), parse_ushort},
+    {"ld", sizeof(long), parse_long},
+    {"lf", sizeof(double), parse_double},
+    {"lu", sizeof(unsigned long), parse_ulong},
+    {"u", sizeof(unsigned int), parse_uint}
+};
 
 int prompt(const char *message, const char *format, ...)
 {
+    // Holding stdin keeps the message and its input together
+    // when other threads are prompting too.
+    flockfile(stdin);
     printf("%s", message);
 
-    if (format == NULL)
+    va_list args;
+    va_start(args, format);
+
+    int result = vprompt(format, NULL, NULL, &args);
+
+    va_end(args);
+    funlockfile(stdin);
+
+    return result;
+}
+
+int prompt_timeout(const char *message, int timeout_ms, PromptResume *resume,
+                   const char *format, ...)
+{
+    if (resume == NULL || !(is_timeout_supported(timeout_ms)))
     {
         return 0;
     }
 
-    int result = READ_NONE;
-    int successfully_read = 0;
-    char *format_alloc = str_alloc(format);
+    flockfile(stdin);
 
-    if (format_alloc == NULL)
+    // A resumed prompt is still on the screen.
+    if (resume->read == 0 && resume->length == 0)
     {
-        return 0;
+        printf("%s", message);
     }
 
-    char *format_copy = format_alloc;
-    char *specifier = strsep_chars(&format_copy, "%");
+    // The message has to be shown before we start waiting.
+    fflush(stdout);
 
+    Deadline deadline;
     va_list args;
     va_start(args, format);
 
-    while (format_copy != NULL)
-    {
-        specifier = strsep_chars(&format_copy, "%");
-        result = parse_format(&args, specifier,
-                    (format_copy != NULL), &successfully_read);
-
-        if (result != READ_SUCCESS)
-        {
-            break;
-        }
-    }
+    int result = vprompt(format, deadline_init(&deadline, timeout_ms), resume, &args);
 
     va_end(args);
-    free(format_alloc);
+    funlockfile(stdin);
 
-    return (result == READ_EOF) ? EOF : successfully_read;
+    return result;
 }
 
 int prompt_gets(const char *message, char *input, const size_t BUFFER_SIZE)
 {
+    flockfile(stdin);
     printf("%s", message);
-    return prompt_gets_delim_stream(input, BUFFER_SIZE, "\n", true, stdin);
+
+    int result = prompt_gets_delim_stream(input, BUFFER_SIZE, "\n", true, stdin);
+
+    funlockfile(stdin);
+
+    return result;
 }
 
 int prompt_gets_delim(const char *message, char *input,
                       const size_t BUFFER_SIZE, const char *delim,
                       bool matched_delim)
 {
+    flockfile(stdin);
     printf("%s", message);
-    return prompt_gets_delim_stream(input, BUFFER_SIZE, delim, matched_delim, stdin);
+
+    int result = prompt_gets_delim_stream(input, BUFFER_SIZE, delim,
+                                          matched_delim, stdin);
+
+    funlockfile(stdin);
+
+    return result;
 }
 
 int prompt_gets_stream(char *input, const size_t BUFFER_SIZE, FILE *stream)
@@ -136,33 +330,100 @@ int prompt_gets_delim_stream(char *input, const size_t BUFFER_SIZE,
                              const char *delim, bool matched_delim,
                              FILE *stream)
 {
-    if (input == NULL || BUFFER_SIZE == 0 || delim == NULL
-        || stream == NULL || stream == stderr || stream == stdout)
-    {
-        return 0;
-    }
+    return prompt_gets_delim_stream_timeout(input, BUFFER_SIZE, delim,
+                                            matched_delim, stream, -1);
+}
 
-    if (feof(stream))
+int prompt_gets_timeout(const char *message, char *input,
+                        const size_t BUFFER_SIZE, int timeout_ms)
+{
+    flockfile(stdin);
+    printf("%s", message);
+
+    // The message has to be shown before we start waiting.
+    fflush(stdout);
+
+    int result = prompt_gets_delim_stream_timeout(input, BUFFER_SIZE, "\n",
+                                                  true, stdin, timeout_ms);
+
+    funlockfile(stdin);
+
+    return result;
+}
+
+int prompt_gets_delim_stream_timeout(char *input, const size_t BUFFER_SIZE,
+                                     const char *delim, bool matched_delim,
+                                     FILE *stream, int timeout_ms)
+{
+    return parse_gets(input, BUFFER_SIZE, delim, matched_delim, stream,
+                      timeout_ms, false);
+}
+
+int prompt_gets_utf8(const char *message, char *input, const size_t BUFFER_SIZE)
+{
+    flockfile(stdin);
+    printf("%s", message);
+
+    int result = prompt_gets_delim_stream_utf8(input, BUFFER_SIZE, "\n", true, stdin);
+
+    funlockfile(stdin);
+
+    return result;
+}
+
+int prompt_gets_delim_utf8(const char *message, char *input,
+                           const size_t BUFFER_SIZE, const char *delim,
+                           bool matched_delim)
+{
+    flockfile(stdin);
+    printf("%s", message);
+
+    int result = prompt_gets_delim_stream_utf8(input, BUFFER_SIZE, delim,
+                                               matched_delim, stdin);
+
+    funlockfile(stdin);
+
+    return result;
+}
+
+int prompt_gets_delim_stream_utf8(char *input, const size_t BUFFER_SIZE,
+                                  const char *delim, bool matched_delim,
+                                  FILE *stream)
+{
+    if (delim == NULL || !(is_utf8(delim, strlen(delim))))
     {
-        return EOF;
+        return 0;
     }
 
-    parse_prompt(input, BUFFER_SIZE, NULL, delim, matched_delim, stream);
-
-    return 1;
+    // parse_gets checks every code point as it reads it,
+    // and returns PROMPT_INVALID_UTF8 itself.
+    return parse_gets(input, BUFFER_SIZE, delim, matched_delim, stream,
+                      -1, true);
 }
 
 int prompt_getline(const char *message, char **input)
 {
+    flockfile(stdin);
     printf("%s", message);
-    return prompt_getline_delim_stream(input, "\n", true, stdin);
+
+    int result = prompt_getline_delim_stream(input, "\n", true, stdin);
+
+    funlockfile(stdin);
+
+    return result;
 }
 
 int prompt_getline_delim(const char *message, char **input, const char *delim,
                          bool matched_delim)
 {
+    flockfile(stdin);
     printf("%s", message);
-    return prompt_getline_delim_stream(input, delim, matched_delim, stdin);
+
+    int result = prompt_getline_delim_stream(input, delim, matched_delim, stdin);
+
+    funlockfile(stdin);
+
+    return result;
 }
 
 int prompt_getline_stream(char **input, FILE *stream)
@@ -172,9 +433,34 @@ int prompt_getline_stream(char **input, FILE *stream)
 
 int prompt_getline_delim_stream(char **input, const char *delim,
                                 bool matched_delim, FILE *stream)
+{
+    return prompt_getline_delim_stream_timeout(input, delim, matched_delim,
+                                               stream, -1);
+}
+
+int prompt_getline_timeout(const char *message, char **input, int timeout_ms)
+{
+    flockfile(stdin);
+    printf("%s", message);
+
+    // The message has to be shown before we start waiting.
+    fflush(stdout);
+
+    int result = prompt_getline_delim_stream_timeout(input, "\n", true, stdin,
+                                                     timeout_ms);
+
+    funlockfile(stdin);
+
+    return result;
+}
+
+int prompt_getline_delim_stream_timeout(char **input, const char *delim,
+                                        bool matched_delim, FILE *stream,
+                                        int timeout_ms)
 {
     if (input == NULL || delim == NULL || stream == NULL
-        || stream == stderr || stream == stdout)
+        || stream == stderr || stream == stdout
+        || !(is_timeout_supported(timeout_ms)))
     {
         return 0;
     }
@@ -184,464 +470,1774 @@ int prompt_getline_delim_stream(char **input, const char *delim,
         return EOF;
     }
 
-    size_t i = 0;
-    size_t capacity = 8;
-    int ch = getc(stream);
-    *input = malloc(sizeof(char) * (capacity + 1));
+    // The stream is locked once for the whole read,
+    // so every char can be read without taking the lock.
+    flockfile(stream);
 
-    if (*input == NULL)
+    Deadline deadline;
+    int result = parse_getline(input, delim, matched_delim, stream,
+                               deadline_init(&deadline, timeout_ms));
+
+    funlockfile(stream);
+
+    return result;
+}
+
+int prompt_record_start(FILE *stream, const char *path)
+{
+    if (stream == NULL || path == NULL)
     {
         return 0;
     }
 
-    // FIXME: Add support for delim.
-    while (ch != EOF)
-    {
-        if (is_strchr(delim, ch) == matched_delim)
-        {
-            // Clear only the input buffer. We do not want 
-            // to clear any file buffers.
-            if (stream == stdin)
-            {
-                // Clearing the buffer.
-                while (ch != '\n' && ch != EOF)
-                {
-                    ch = getc(stream);
-                }
-            }
-
-            break;
-        }
-    
-        if (i == capacity)
-        {
-            // FIXME: Check wrap around.
-            capacity = calculate_capacity(capacity + 1);
-            char *new_input = realloc(*input, capacity + 1);
-
-            if (new_input == NULL)
-            {
-                (*input)[i] = '\0';
+    flockfile(stream);
 
-                return 0;
-            }
+    FILE *expected = NULL;
 
-            *input = new_input;
-        }
+    // Only one stream can be recorded at a time.
+    if (!(atomic_compare_exchange_strong(&recorded_stream, &expected, stream)))
+    {
+        funlockfile(stream);
+        return 0;
+    }
 
-        (*input)[i] = (char)ch;
-        i++;
+    // The log is append only, so a new session
+    // goes after any sessions already in it.
+    recorder.log = fopen(path, "ab");
 
-        ch = getc(stream);
+    if (recorder.log == NULL)
+    {
+        atomic_store(&recorded_stream, NULL);
+        funlockfile(stream);
+        return 0;
     }
 
-    (*input)[i] = '\0';
+    if (ftell(recorder.log) == 0)
+    {
+        fwrite(LOG_MAGIC, 1, LOG_MAGIC_SIZE, recorder.log);
+    }
 
-    return 1;
-}
+    recorder.length = 0;
+    clock_gettime(CLOCK_MONOTONIC, &recorder.last);
 
-static char *str_alloc(const char *s)
-{
-    size_t size = strlen(s) + 1;
-    char *str = malloc(sizeof(char) * size);
+    fputc(LOG_SESSION, recorder.log);
+    write_varint(recorder.log, 0);
+    write_varint(recorder.log, (uint64_t)time(NULL));
+    fflush(recorder.log);
 
-    if (str != NULL)
-    {
-        memcpy(str, s, size);
-    }
+    funlockfile(stream);
 
-    return str;
+    return 1;
 }
 
-// Separates a str with a multi-character delimiter.
-static char *strsep_chars(char **data, const char *separator)
+void prompt_record_stop(void)
 {
-    if (*data == NULL)
+    FILE *stream = atomic_load(&recorded_stream);
+
+    if (stream == NULL)
     {
-        return *data;
+        return;
     }
 
-    char *end = strstr(*data, separator);
-    char *temp = *data;
+    flockfile(stream);
 
-    if (end == NULL)
+    // Another thread may have stopped the recording while we waited for the lock.
+    if (atomic_load(&recorded_stream) != stream)
     {
-        *data = NULL;
-        return temp;
+        funlockfile(stream);
+        return;
     }
 
-    *end = '\0';
-    *data = end + strlen(separator);
+    record_chunk();
+    fclose(recorder.log);
+    recorder.log = NULL;
+    atomic_store(&recorded_stream, NULL);
 
-    return temp;
+    funlockfile(stream);
 }
 
-static int parse_format(va_list *args, const char *specifier,
-                        bool multple_specifiers, int *successfully_read)
+FILE *prompt_replay_open(const char *path, bool original_timing)
 {
-    ArgumentType arg_type;
-    ArgumentParser parse_arg = parse_types;
-
-    arg_type.status = READ_NONE;
-    arg_type.options = (multple_specifiers | STOP_AT_SPACE | NUMERICS_ONLY);
-
-    if (!(strncmp(specifier, "c", MAX_FORMAT)))
+    if (path == NULL)
     {
-        arg_type.options &= ~NUMERICS_ONLY;
-        arg_type.get = va_arg_char;
-        arg_type.set = parse_char;
-    }
-    else if (!(strncmp(specifier, "d", MAX_FORMAT)))
-    {
-        arg_type.get = va_arg_int;
-        arg_type.set = parse_int;
+        return NULL;
     }
-    else if (!(strncmp(specifier, "f", MAX_FORMAT)))
-    {
-        arg_type.get = va_arg_float;
-        arg_type.set = parse_float;
-    }
-    else if (!(strncmp(specifier, "hi", MAX_FORMAT)))
+
+    FILE *log = fopen(path, "rb");
+
+    if (log == NULL)
     {
-        arg_type.get = va_arg_short;
-        arg_type.set = parse_short;
+        return NULL;
     }
-    else if (!(strncmp(specifier, "hu", MAX_FORMAT)))
+
+    Replay *replay = calloc(1, sizeof(Replay));
+    long size = (fseek(log, 0, SEEK_END) == 0) ? ftell(log) : -1;
+
+    if (replay == NULL || size < LOG_MAGIC_SIZE)
     {
-        arg_type.get = va_arg_ushort;
-        arg_type.set = parse_ushort;
+        free(replay);
+        fclose(log);
+        return NULL;
     }
-    else if (!(strncmp(specifier, "ld", MAX_FORMAT)))
+
+    replay->size = (size_t)size;
+    replay->log = malloc(replay->size);
+    rewind(log);
+
+    if (replay->log == NULL || fread(replay->log, 1, replay->size, log) != replay->size
+        || memcmp(replay->log, LOG_MAGIC, LOG_MAGIC_SIZE) != 0)
     {
-        arg_type.get = va_arg_long;
-        arg_type.set = parse_long;
+        free(replay->log);
+        free(replay);
+        fclose(log);
+        return NULL;
     }
-    else if (!(strncmp(specifier, "lf", MAX_FORMAT)))
+
+    fclose(log);
+
+    replay->position = LOG_MAGIC_SIZE;
+    replay->original_timing = original_timing;
+    clock_gettime(CLOCK_MONOTONIC, &replay->next);
+
+    FILE *stream = replay_stream(replay);
+
+    if (stream == NULL)
     {
-        arg_type.get = va_arg_double;
-        arg_type.set = parse_double;
+        free(replay->log);
+        free(replay);
     }
-    else if (!(strncmp(specifier, "lu", MAX_FORMAT)))
+
+    return stream;
+}
+
+int prompt_table_load(const char *path, const char *format, bool use_cache,
+                      PromptTable *table)
+{
+    if (path == NULL || format == NULL || table == NULL)
     {
-        arg_type.get = va_arg_ulong;
-        arg_type.set = parse_ulong;
+        return 0;
     }
-    else if (!(strncmp(specifier, "u", MAX_FORMAT)))
+
+    memset(table, 0, sizeof(PromptTable));
+
+    size_t columns = 0;
+    const ColumnType **types = parse_columns(format, &columns);
+    struct stat source;
+
+    if (types == NULL || stat(path, &source) == -1)
     {
-        arg_type.get = va_arg_uint;
-        arg_type.set = parse_uint;
+        free(types);
+        return 0;
     }
-    else if (!(strncmp(specifier, "s", MAX_FORMAT)))
+
+    char *cache = use_cache ? cache_path(path, format) : NULL;
+
+    if (cache && load_cache(cache, &source, format, types, columns, table))
     {
-        arg_type.options &= ~NUMERICS_ONLY;
-        parse_arg = parse_str;
+        free(cache);
+        free(types);
+        return 1;
     }
-    else
+
+    if (!(parse_table(path, types, columns, table)))
     {
-        exit(EXIT_FAILURE);
+        free(cache);
+        free(types);
+        return 0;
     }
 
-    parse_arg(&arg_type, args);
+    struct stat after;
 
-    // If the user enters in a series of numbers like:
-    // 12L 5 9
-    // we still want to read in "12" and also increament 
-    // our successfully read counter. However we discard the
-    // rest of the input because of the 'L' and stop reading
-    // all together.
-    if (arg_type.status & (READ_SUCCESS|READ_NON_NUMERIC))
+    // Do not cache a file that changed while we were reading it,
+    // or one that could still change without its mtime showing it.
+    if (cache && stat(path, &after) == 0 && is_same_file(&source, &after)
+        && time(NULL) - source.st_mtime >= CACHE_RACY_SECONDS)
     {
-        (*successfully_read)++;
+        write_cache(cache, &source, format, types, table);
     }
 
-    return arg_type.status;
+    free(cache);
+    free(types);
+
+    return 1;
 }
 
-static void parse_types(ArgumentType *arg_type, va_list *args)
+void prompt_table_free(PromptTable *table)
 {
-    char input[MAX_READ] = {0};
-    void *arg_value = arg_type->get(args);
-
-    parse_prompt(input, MAX_READ, arg_type, "\n", true, stdin);
-
-    if (arg_type->status & (READ_EOF|READ_FAILURE))
+    if (table == NULL)
     {
         return;
     }
 
-    arg_type->set(arg_value, input);
-
-    if (arg_type->status == READ_NON_NUMERIC)
+    if (table->mapping != NULL)
     {
-        return;
+        munmap(table->mapping, table->mapping_size);
+    }
+    else if (table->data != NULL)
+    {
+        for (size_t i = 0; i < table->columns; i++)
+        {
+            free(table->data[i]);
+        }
+    }
+
+    free(table->data);
+    memset(table, 0, sizeof(PromptTable));
+}
+
+static int parse_getline(char **input, const char *delim, bool matched_delim,
+                         FILE *stream, const Deadline *deadline)
+{
+    size_t i = 0;
+    size_t capacity = 8;
+    int ch = read_char(stream, deadline);
+    *input = malloc(sizeof(char) * (capacity + 1));
+
+    if (*input == NULL)
+    {
+        return 0;
+    }
+
+    // FIXME: Add support for delim.
+    while (ch != EOF && ch != PROMPT_TIMEOUT)
+    {
+        if (is_strchr(delim, ch) == matched_delim)
+        {
+            ch = clear_input(stream, ch, deadline);
+            break;
+        }
+    
+        if (i == capacity)
+        {
+            // FIXME: Check wrap around.
+            capacity = calculate_capacity(capacity + 1);
+            char *new_input = realloc(*input, capacity + 1);
+
+            if (new_input == NULL)
+            {
+                (*input)[i] = '\0';
+
+                return 0;
+            }
+
+            *input = new_input;
+        }
+
+        (*input)[i] = (char)ch;
+        i++;
+
+        ch = read_char(stream, deadline);
+    }
+
+    (*input)[i] = '\0';
+
+    return (ch == PROMPT_TIMEOUT) ? PROMPT_TIMEOUT : 1;
+}
+
+static int parse_gets(char *input, const size_t BUFFER_SIZE, const char *delim,
+                      bool matched_delim, FILE *stream, int timeout_ms, bool utf8)
+{
+    if (input == NULL || BUFFER_SIZE == 0 || delim == NULL
+        || stream == NULL || stream == stderr || stream == stdout
+        || !(is_timeout_supported(timeout_ms)))
+    {
+        return 0;
+    }
+
+    if (feof(stream))
+    {
+        return EOF;
+    }
+
+    // The stream is locked once for the whole read,
+    // so every char can be read without taking the lock.
+    flockfile(stream);
+
+    Deadline deadline;
+    bool invalid_utf8 = false;
+    int ch = parse_prompt(input, BUFFER_SIZE, NULL, delim, matched_delim,
+                          stream, deadline_init(&deadline, timeout_ms),
+                          utf8 ? &invalid_utf8 : NULL);
+
+    funlockfile(stream);
+
+    if (ch == PROMPT_TIMEOUT)
+    {
+        return PROMPT_TIMEOUT;
+    }
+
+    return invalid_utf8 ? PROMPT_INVALID_UTF8 : 1;
+}
+
+// resume is only used by prompt_timeout, it is NULL otherwise.
+static int vprompt(const char *format, const Deadline *deadline,
+                   PromptResume *resume, va_list *args)
+{
+    if (format == NULL)
+    {
+        return 0;
+    }
+
+    int result = READ_NONE;
+    int successfully_read = 0;
+    char *format_alloc = str_alloc(format);
+
+    if (format_alloc == NULL)
+    {
+        return 0;
+    }
+
+    char *format_copy = format_alloc;
+    char *specifier = strsep_chars(&format_copy, "%");
+
+    while (format_copy != NULL)
+    {
+        specifier = strsep_chars(&format_copy, "%");
+        result = parse_format(args, specifier, (format_copy != NULL),
+                              deadline, resume, &successfully_read);
+
+        if (result != READ_SUCCESS)
+        {
+            break;
+        }
+    }
+
+    free(format_alloc);
+
+    // The partial field was already saved by the specifier that timed out.
+    if (result == READ_TIMEOUT)
+    {
+        resume->read = successfully_read;
+        return PROMPT_TIMEOUT;
+    }
+
+    if (resume != NULL)
+    {
+        resume->read = 0;
+        resume->length = 0;
+    }
+
+    return (result == READ_EOF) ? EOF : successfully_read;
+}
+
+// Chars that arrive in the same refill of the stream's buffer
+// share one record and one timestamp, even across calls.
+static int record_char(FILE *stream)
+{
+    // The stream has to read more, so these chars arrived
+    // just now and go in a new chunk.
+    if (!(is_buffered(stream)))
+    {
+        record_chunk();
+    }
+
+    int ch = getc_unlocked(stream);
+
+    if (ch == EOF)
+    {
+        return ch;
+    }
+
+    if (recorder.length == LOG_CHUNK)
+    {
+        record_chunk();
+    }
+
+    if (recorder.length == 0)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &recorder.arrived);
+    }
+
+    recorder.chunk[recorder.length] = (char)ch;
+    recorder.length++;
+
+    return ch;
+}
+
+static void record_chunk(void)
+{
+    if (recorder.length == 0)
+    {
+        return;
+    }
+
+    write_record(LOG_DATA, recorder.length, &recorder.arrived);
+    fwrite(recorder.chunk, 1, recorder.length, recorder.log);
+    recorder.length = 0;
+}
+
+static void record_cleared(FILE *stream, size_t count)
+{
+    if (count == 0
+        || stream != atomic_load_explicit(&recorded_stream, memory_order_relaxed))
+    {
+        return;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    record_chunk();
+    write_record(LOG_CLEARED, count, &now);
+}
+
+static void write_record(int tag, uint64_t value, const struct timespec *when)
+{
+    long long delta = (long long)(when->tv_sec - recorder.last.tv_sec) * 1000000
+                      + (when->tv_nsec - recorder.last.tv_nsec) / 1000;
+
+    // Only whole microseconds are written, the rest
+    // is carried over to the next record.
+    recorder.last.tv_sec += delta / 1000000;
+    recorder.last.tv_nsec += (delta % 1000000) * 1000;
+
+    if (recorder.last.tv_nsec >= 1000000000L)
+    {
+        recorder.last.tv_sec++;
+        recorder.last.tv_nsec -= 1000000000L;
+    }
+
+    fputc(tag, recorder.log);
+    write_varint(recorder.log, (delta > 0) ? (uint64_t)delta : 0);
+    write_varint(recorder.log, value);
+}
+
+// LEB128, 7 bits at a time with the high bit set
+// on every byte but the last.
+static void write_varint(FILE *log, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        fputc((int)((value & 0x7F) | 0x80), log);
+        value >>= 7;
+    }
+
+    fputc((int)value, log);
+}
+
+static bool read_varint(Replay *replay, uint64_t *value)
+{
+    *value = 0;
+
+    for (unsigned int shift = 0; shift < 64; shift += 7)
+    {
+        if (replay->position == replay->size)
+        {
+            return false;
+        }
+
+        unsigned char byte = replay->log[replay->position];
+        replay->position++;
+        *value |= (uint64_t)(byte & 0x7F) << shift;
+
+        if (!(byte & 0x80))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Moves to the next LOG_DATA record, waiting until its original
+// time if asked to. A truncated or corrupt log just ends the replay.
+static bool next_record(Replay *replay)
+{
+    while (replay->position < replay->size)
+    {
+        int tag = replay->log[replay->position];
+        uint64_t delta = 0;
+        uint64_t value = 0;
+
+        replay->position++;
+
+        if (!(read_varint(replay, &delta)) || !(read_varint(replay, &value)))
+        {
+            return false;
+        }
+
+        replay->next.tv_sec += (time_t)(delta / 1000000);
+        replay->next.tv_nsec += (long)(delta % 1000000) * 1000;
+
+        if (replay->next.tv_nsec >= 1000000000L)
+        {
+            replay->next.tv_sec++;
+            replay->next.tv_nsec -= 1000000000L;
+        }
+
+        if (tag == LOG_SESSION)
+        {
+            // The gap between sessions was not recorded.
+            clock_gettime(CLOCK_MONOTONIC, &replay->next);
+        }
+        else if (tag == LOG_DATA)
+        {
+            if (value > replay->size - replay->position)
+            {
+                return false;
+            }
+
+            replay->data = &replay->log[replay->position];
+            replay->remaining = (size_t)value;
+            replay->position += (size_t)value;
+
+            while (replay->original_timing
+                   && clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+                                      &replay->next, NULL) == EINTR)
+            {
+            }
+
+            return true;
+        }
+        else if (tag != LOG_CLEARED)
+        {
+            return false;
+        }
+    }
+
+    return false;
+}
+
+static size_t replay_read(Replay *replay, char *buffer, size_t size)
+{
+    while (replay->remaining == 0)
+    {
+        if (!(next_record(replay)))
+        {
+            return 0;
+        }
+    }
+
+    size_t length = (size < replay->remaining) ? size : replay->remaining;
+
+    memcpy(buffer, replay->data, length);
+    replay->data += length;
+    replay->remaining -= length;
+
+    return length;
+}
+
+#if defined(__GLIBC__)
+static ssize_t replay_cookie_read(void *cookie, char *buffer, size_t size)
+{
+    return (ssize_t)replay_read(cookie, buffer, size);
+}
+
+static int replay_cookie_close(void *cookie)
+{
+    Replay *replay = cookie;
+
+    free(replay->log);
+    free(replay);
+
+    return 0;
+}
+
+static FILE *replay_stream(Replay *replay)
+{
+    cookie_io_functions_t functions = {
+        .read = replay_cookie_read,
+        .close = replay_cookie_close
+    };
+
+    return fopencookie(replay, "r", functions);
+}
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__)
+static int replay_cookie_read(void *cookie, char *buffer, int size)
+{
+    return (int)replay_read(cookie, buffer, (size_t)size);
+}
+
+static int replay_cookie_close(void *cookie)
+{
+    Replay *replay = cookie;
+
+    free(replay->log);
+    free(replay);
+
+    return 0;
+}
+
+static FILE *replay_stream(Replay *replay)
+{
+    return funopen(replay, replay_cookie_read, NULL, NULL, replay_cookie_close);
+}
+#else
+// There is no way to make a custom stream here.
+static FILE *replay_stream(Replay *replay)
+{
+    (void)replay;
+    return NULL;
+}
+#endif
+
+static char *str_alloc(const char *s)
+{
+    size_t size = strlen(s) + 1;
+    char *str = malloc(sizeof(char) * size);
+
+    if (str != NULL)
+    {
+        memcpy(str, s, size);
+    }
+
+    return str;
+}
+
+// Separates a str with a multi-character delimiter.
+static char *strsep_chars(char **data, const char *separator)
+{
+    if (*data == NULL)
+    {
+        return *data;
+    }
+
+    char *end = strstr(*data, separator);
+    char *temp = *data;
+
+    if (end == NULL)
+    {
+        *data = NULL;
+        return temp;
+    }
+
+    *end = '\0';
+    *data = end + strlen(separator);
+
+    return temp;
+}
+
+static int parse_format(va_list *args, const char *specifier,
+                        bool multple_specifiers, const Deadline *deadline,
+                        PromptResume *resume, int *successfully_read)
+{
+    ArgumentType arg_type;
+    ArgumentParser parse_arg = parse_types;
+
+    arg_type.status = READ_NONE;
+    arg_type.options = (multple_specifiers | STOP_AT_SPACE | NUMERICS_ONLY);
+    arg_type.deadline = deadline;
+    arg_type.resume = resume;
+    arg_type.resumed = 0;
+
+    if (!(strncmp(specifier, "c", MAX_FORMAT)))
+    {
+        arg_type.options &= ~NUMERICS_ONLY;
+        arg_type.get = va_arg_char;
+        arg_type.set = parse_char;
+    }
+    else if (!(strncmp(specifier, "d", MAX_FORMAT)))
+    {
+        arg_type.get = va_arg_int;
+        arg_type.set = parse_int;
+    }
+    else if (!(strncmp(specifier, "f", MAX_FORMAT)))
+    {
+        arg_type.get = va_arg_float;
+        arg_type.set = parse_float;
+    }
+    else if (!(strncmp(specifier, "hi", MAX_FORMAT)))
+    {
+        arg_type.get = va_arg_short;
+        arg_type.set = parse_short;
+    }
+    else if (!(strncmp(specifier, "hu", MAX_FORMAT)))
+    {
+        arg_type.get = va_arg_ushort;
+        arg_type.set = parse_ushort;
+    }
+    else if (!(strncmp(specifier, "ld", MAX_FORMAT)))
+    {
+        arg_type.get = va_arg_long;
+        arg_type.set = parse_long;
+    }
+    else if (!(strncmp(specifier, "lf", MAX_FORMAT)))
+    {
+        arg_type.get = va_arg_double;
+        arg_type.set = parse_double;
+    }
+    else if (!(strncmp(specifier, "lu", MAX_FORMAT)))
+    {
+        arg_type.get = va_arg_ulong;
+        arg_type.set = parse_ulong;
+    }
+    else if (!(strncmp(specifier, "u", MAX_FORMAT)))
+    {
+        arg_type.get = va_arg_uint;
+        arg_type.set = parse_uint;
+    }
+    else if (!(strncmp(specifier, "s", MAX_FORMAT)))
+    {
+        arg_type.options &= ~NUMERICS_ONLY;
+        parse_arg = parse_str;
+    }
+    else
+    {
+        exit(EXIT_FAILURE);
+    }
+
+    // The specifiers filled before a timeout keep their values,
+    // so only their arguments are skipped.
+    if (resume != NULL && *successfully_read < resume->read)
+    {
+        if (parse_arg == parse_str)
+        {
+            va_arg(*args, char*);
+            va_arg(*args, size_t);
+        }
+        else
+        {
+            arg_type.get(args);
+        }
+
+        (*successfully_read)++;
+        return READ_SUCCESS;
+    }
+
+    parse_arg(&arg_type, args);
+
+    // If the user enters in a series of numbers like:
+    // 12L 5 9
+    // we still want to read in "12" and also increament 
+    // our successfully read counter. However we discard the
+    // rest of the input because of the 'L' and stop reading
+    // all together.
+    if (arg_type.status & (READ_SUCCESS|READ_NON_NUMERIC))
+    {
+        (*successfully_read)++;
+    }
+
+    return arg_type.status;
+}
+
+static void parse_types(ArgumentType *arg_type, va_list *args)
+{
+    char input[MAX_READ] = {0};
+    void *arg_value = arg_type->get(args);
+    PromptResume *resume = arg_type->resume;
+
+    // Carry on with the chars read before the last timeout.
+    if (resume != NULL)
+    {
+        memcpy(input, resume->field, resume->length);
+        arg_type->resumed = resume->length;
+        resume->length = 0;
+    }
+
+    parse_prompt(input, MAX_READ, arg_type, "\n", true, stdin,
+                 arg_type->deadline, NULL);
+
+    if (arg_type->status == READ_TIMEOUT)
+    {
+        resume->length = strlen(input);
+        memcpy(resume->field, input, resume->length);
+    }
+
+    if (arg_type->status & (READ_EOF|READ_FAILURE|READ_TIMEOUT))
+    {
+        return;
+    }
+
+    arg_type->set(arg_value, input);
+
+    if (arg_type->status == READ_NON_NUMERIC)
+    {
+        return;
+    }
+
+    arg_type->status = READ_SUCCESS;
+}
+
+static void *va_arg_char(va_list *args)
+{
+    return (void*)va_arg(*args, char*);
+}
+
+static void parse_char(void *arg, const char *str)
+{
+    char *char_arg = (char*)arg;
+    *char_arg = str[0];
+}
+
+static void *va_arg_int(va_list *args)
+{
+    return (void*)va_arg(*args, int*);
+}
+
+static void parse_int(void *arg, const char *str)
+{
+    long number = strtol(str, NULL, 10);
+    int *int_arg = (int*)arg;
+
+    if (number < INT32_MIN)
+    {
+        *int_arg = INT32_MIN;
+    }
+    else if (number > INT32_MAX)
+    {
+        *int_arg = INT32_MAX;
+    }
+    else
+    {
+        *int_arg = (int)number;
+    }
+}
+
+static void *va_arg_float(va_list *args)
+{
+    return (void*)va_arg(*args, float*);
+}
+
+static void parse_float(void *arg, const char *str)
+{
+    float *float_arg = (float*)arg;
+    *float_arg = strtof(str, NULL);
+}
+
+static void *va_arg_short(va_list *args)
+{
+    return (void*)va_arg(*args, short*);
+}
+
+static void parse_short(void *arg, const char *str)
+{
+    long number = strtol(str, NULL, 10);
+    short *short_arg = (short*)arg;
+
+    if (number < SHRT_MIN)
+    {
+        *short_arg = SHRT_MIN;
+    }
+    else if (number > SHRT_MAX)
+    {
+        *short_arg = SHRT_MAX;
+    }
+    else
+    {
+        *short_arg = (short)number;
+    }
+}
+
+static void *va_arg_ushort(va_list *args)
+{
+    return (void*)va_arg(*args, unsigned short*);
+}
+
+static void parse_ushort(void *arg, const char *str)
+{
+    long number = strtol(str, NULL, 10);
+    unsigned short *ushort_arg = (unsigned short*)arg;
+
+    if (number > USHRT_MAX || number <= USHRT_MIN)
+    {
+        *ushort_arg = USHRT_MAX;
+    }
+    else
+    {
+        *ushort_arg = (unsigned short)number;
+    }
+}
+
+static void *va_arg_long(va_list *args)
+{
+    return (void*)va_arg(*args, long*);
+}
+
+static void parse_long(void *arg, const char *str)
+{
+    long *long_arg = (long*)arg;
+    *long_arg = strtol(str, NULL, 10);
+}
+
+static void *va_arg_double(va_list *args)
+{
+    return (void*)va_arg(*args, double*);
+}
+
+static void parse_double(void *arg, const char *str)
+{
+    double *double_arg = (double*)arg;
+    *double_arg = strtod(str, NULL);
+}
+
+static void *va_arg_ulong(va_list *args)
+{
+    return (void*)va_arg(*args, unsigned long*);
+}
+
+static void parse_ulong(void *arg, const char *str)
+{
+    unsigned long *ulong_arg = (unsigned long*)arg;
+    *ulong_arg = strtoul(str, NULL, 10);
+}
+
+static void *va_arg_uint(va_list *args)
+{
+    return (void*)va_arg(*args, unsigned int*);
+}
+
+static void parse_uint(void *arg, const char *str)
+{
+    long number = strtol(str, NULL, 10);
+    unsigned int *uint_arg = (unsigned int*)arg;
+
+    if (number > UINT32_MAX || number <= UINT32_MIN)
+    {
+        *uint_arg = UINT32_MAX;
+    }
+    else
+    {
+        *uint_arg = (unsigned int)number;
+    }
+}
+
+static void parse_str(ArgumentType *arg_type, va_list *args)
+{
+    char *input = va_arg(*args, char*);
+    const size_t BUFFER_SIZE = va_arg(*args, size_t);
+
+    if (BUFFER_SIZE == 0)
+    {
+        arg_type->status = READ_FAILURE;
+        return;
+    }
+
+    // The chars read before the last timeout are still in input.
+    if (arg_type->resume != NULL)
+    {
+        arg_type->resumed = (arg_type->resume->length < BUFFER_SIZE)
+                            ? arg_type->resume->length : 0;
+        arg_type->resume->length = 0;
+    }
+
+    parse_prompt(input, BUFFER_SIZE, arg_type, "\n", true, stdin,
+                 arg_type->deadline, NULL);
+
+    if (arg_type->status == READ_TIMEOUT)
+    {
+        arg_type->resume->length = strlen(input);
+    }
+
+    if (arg_type->status & (READ_EOF|READ_TIMEOUT))
+    {
+        return;
     }
 
     arg_type->status = READ_SUCCESS;
 }
 
-static void *va_arg_char(va_list *args)
+// This function was inspired by this video:
+// https://youtu.be/NsB6dqvVu7Y?t=231
+// Returns the last char read, which is PROMPT_TIMEOUT
+// if the deadline passed before the field was complete.
+// invalid_utf8 turns on UTF-8 mode when it is not NULL, and it
+// is set if any invalid UTF-8 is read, stored or not.
+static int parse_prompt(char *input, const size_t BUFFER_SIZE, ArgumentType *arg_type,
+                        const char *delim, bool matched_delim, FILE *stream,
+                        const Deadline *deadline, bool *invalid_utf8)
 {
-    return (void*)va_arg(*args, char*);
+    int ch = read_char(stream, deadline);
+    size_t i = arg_type ? arg_type->resumed : 0;
+    size_t last_index = BUFFER_SIZE - 1;
+
+    // If you are only using the prompt function,
+    // we do not want you to read any newlines or spaces first.
+    // A resumed field has already started.
+    if (arg_type && i == 0)
+    {
+        while (ch == '\n' || ch == ' ')
+        {
+            ch = read_char(stream, deadline);
+        }
+    }
+
+    while (ch != EOF && ch != PROMPT_TIMEOUT
+           && !(is_multiple_specifiers(arg_type, ch)))
+    {
+        // In UTF-8 mode a multi-byte code point is read whole,
+        // so it can match a delim and is never cut in half.
+        // ASCII chars take the same path as before.
+        if (invalid_utf8 && ch >= 0x80)
+        {
+            char code_point[4];
+            size_t length = read_code_point(code_point, ch, stream, deadline);
+            bool valid = code_point_length((const unsigned char*)code_point, length)
+                         == length;
+
+            // An invalid sequence is never one of the delims.
+            if (!valid)
+            {
+                *invalid_utf8 = true;
+            }
+
+            if ((valid && is_strseq(delim, code_point, length)) == matched_delim)
+            {
+                ch = clear_input(stream, ch, deadline);
+                break;
+            }
+
+            // Once a code point does not fit, nothing
+            // after it is stored either.
+            if (i + length <= last_index)
+            {
+                memcpy(&input[i], code_point, length);
+                i += length;
+            }
+            else
+            {
+                last_index = i;
+            }
+
+            ch = read_char(stream, deadline);
+            continue;
+        }
+
+        // I can't remember why is_strchr has to go first.
+        // I think it caused some bug, but I don't remember
+        // what bug or how to replicate it.
+        if (is_strchr(delim, ch) == matched_delim
+            || is_space(arg_type, ch)
+            || is_non_numeric(arg_type, ch))
+        {
+            ch = clear_input(stream, ch, deadline);
+            break;
+        }
+
+        // Even if we reach the BUFFER_SIZE we should
+        // not clear the input buffer as there could be
+        // multiple specifiers.
+        if (i != last_index)
+        {
+            input[i] = (char)ch;
+            i++;
+        }
+
+        ch = read_char(stream, deadline);
+    }
+
+    input[i] = '\0';
+
+    // It should be a failure if the first index is 0.
+    if (arg_type && input[0] == '\0')
+    {
+        arg_type->status = READ_FAILURE;
+    }
+
+    // It could be the eof.
+    if (arg_type && ch == EOF)
+    {
+        arg_type->status = READ_EOF;
+    }
+
+    // Or we ran out of time.
+    if (arg_type && ch == PROMPT_TIMEOUT)
+    {
+        arg_type->status = READ_TIMEOUT;
+    }
+
+    return ch;
+}
+
+// Clear only the input buffer. We do not want
+// to clear any file buffers.
+static int clear_input(FILE *stream, int ch, const Deadline *deadline)
+{
+    if (stream != stdin)
+    {
+        return ch;
+    }
+
+    size_t count = 0;
+
+    // Clearing the buffer.
+    while (ch != '\n' && ch != EOF && ch != PROMPT_TIMEOUT)
+    {
+        ch = read_char(stream, deadline);
+
+        if (ch >= 0)
+        {
+            count++;
+        }
+    }
+
+    record_cleared(stream, count);
+
+    // The delim was already found, so running out
+    // of time while clearing the buffer does not count.
+    return (ch == PROMPT_TIMEOUT) ? '\n' : ch;
+}
+
+static bool is_multiple_specifiers(ArgumentType *arg_type, int ch)
+{
+    return (arg_type && (arg_type->options & MULTIPLE_SPECIFIERS) && ch == ' ');
+}
+
+static bool is_strchr(const char *s, int ch)
+{
+    return (bool)(strchr(s, ch));
+}
+
+static bool is_space(ArgumentType *arg_type, int ch)
+{
+    return (arg_type && (arg_type->options & STOP_AT_SPACE) && ch == ' ');
+}
+
+static bool is_non_numeric(ArgumentType *arg_type, int ch)
+{
+    if (arg_type && (arg_type->options & NUMERICS_ONLY)
+        && !((ch >= '0' && ch <= '9') || ch == '.' || ch == '-' ||
+            ch == '+'  || ch == 'e' || ch == 'E'))
+    {
+        arg_type->status = READ_NON_NUMERIC;
+        return true;
+    }
+
+    return false;
+}
+
+static size_t calculate_capacity(size_t capacity)
+{
+    return ((capacity >> 3) + (capacity < 9 ? 3 : 6)) + capacity;
+}
+
+// Waiting forever works everywhere, a deadline needs BUFFER_VISIBLE.
+static bool is_timeout_supported(int timeout_ms)
+{
+    return timeout_ms < 0 || BUFFER_VISIBLE;
+}
+
+// A negative timeout means there is no deadline.
+static const Deadline *deadline_init(Deadline *deadline, int timeout_ms)
+{
+    if (timeout_ms < 0)
+    {
+        return NULL;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline->end);
+
+    deadline->end.tv_sec += timeout_ms / 1000;
+    deadline->end.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+
+    if (deadline->end.tv_nsec >= 1000000000L)
+    {
+        deadline->end.tv_sec++;
+        deadline->end.tv_nsec -= 1000000000L;
+    }
+
+    return deadline;
+}
+
+// Milliseconds left until the deadline, rounded up
+// so poll does not wake up right before it.
+static int deadline_remaining(const Deadline *deadline)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    long long remaining = (long long)(deadline->end.tv_sec - now.tv_sec) * 1000
+                          + (deadline->end.tv_nsec - now.tv_nsec + 999999L) / 1000000L;
+
+    if (remaining <= 0)
+    {
+        return 0;
+    }
+
+    return (remaining > INT_MAX) ? INT_MAX : (int)remaining;
+}
+
+// Only waits on the fd when the stream's buffer is empty,
+// so buffered input costs nothing extra.
+static int read_char(FILE *stream, const Deadline *deadline)
+{
+    if (deadline && !is_buffered(stream) && !wait_readable(stream, deadline))
+    {
+        return PROMPT_TIMEOUT;
+    }
+
+    if (stream == atomic_load_explicit(&recorded_stream, memory_order_relaxed))
+    {
+        return record_char(stream);
+    }
+
+    // The caller holds the lock on the stream.
+    return getc_unlocked(stream);
+}
+
+// A recorded char is taken back out of the chunk, so it
+// is only logged once, when it is read again.
+static void unread_char(int ch, FILE *stream)
+{
+    ungetc(ch, stream);
+
+    // record_char always leaves the last char it read
+    // at the end of the chunk.
+    if (stream == atomic_load_explicit(&recorded_stream, memory_order_relaxed)
+        && recorder.length > 0)
+    {
+        recorder.length--;
+    }
+}
+
+// There is no standard way to peek into a FILE's buffer. On other
+// platforms we say it is empty. That only makes recording write more
+// records, since deadlines are turned off there (see BUFFER_VISIBLE).
+static bool is_buffered(FILE *stream)
+{
+#if defined(__GLIBC__)
+    return stream->_IO_read_ptr < stream->_IO_read_end;
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__)
+    return stream->_r > 0;
+#else
+    (void)stream;
+    return false;
+#endif
+}
+
+static bool wait_readable(FILE *stream, const Deadline *deadline)
+{
+    int fd = fileno(stream);
+
+    // Streams like fmemopen have no fd, so they never block.
+    if (fd < 0)
+    {
+        return true;
+    }
+
+    struct pollfd pfd = {.fd = fd, .events = POLLIN};
+
+    while (true)
+    {
+        int result = poll(&pfd, 1, deadline_remaining(deadline));
+
+        if (result > 0)
+        {
+            return true;
+        }
+
+        if (result == 0)
+        {
+            return false;
+        }
+
+        // Let getc report any other error as EOF.
+        if (errno != EINTR)
+        {
+            return true;
+        }
+    }
 }
 
-static void parse_char(void *arg, const char *str)
-{
-    char *char_arg = (char*)arg;
-    *char_arg = str[0];
-}
+// Reads the continuation bytes that follow the lead byte ch.
+// Invalid sequences are kept as they are, parse_prompt reports them.
+static size_t read_code_point(char *code_point, int ch, FILE *stream,
+                              const Deadline *deadline)
+{
+    size_t expected = utf8_length((unsigned char)ch);
+    size_t length = 1;
+
+    code_point[0] = (char)ch;
+
+    while (length < expected)
+    {
+        ch = read_char(stream, deadline);
+
+        // Not a continuation byte, so it starts the next char.
+        // EOF and PROMPT_TIMEOUT are negative and are read again.
+        if (ch < 0x80 || ch > 0xBF)
+        {
+            if (ch >= 0)
+            {
+                unread_char(ch, stream);
+            }
+
+            break;
+        }
+
+        code_point[length] = (char)ch;
+        length++;
+    }
 
-static void *va_arg_int(va_list *args)
-{
-    return (void*)va_arg(*args, int*);
+    return length;
 }
 
-static void parse_int(void *arg, const char *str)
+// The number of bytes a code point starting with lead should have.
+static size_t utf8_length(unsigned char lead)
 {
-    long number = strtol(str, NULL, 10);
-    int *int_arg = (int*)arg;
-
-    if (number < INT32_MIN)
+    if (lead >= 0xC2 && lead <= 0xDF)
     {
-        *int_arg = INT32_MIN;
+        return 2;
     }
-    else if (number > INT32_MAX)
+
+    if (lead >= 0xE0 && lead <= 0xEF)
     {
-        *int_arg = INT32_MAX;
+        return 3;
     }
-    else
+
+    if (lead >= 0xF0 && lead <= 0xF4)
     {
-        *int_arg = (int)number;
+        return 4;
     }
-}
 
-static void *va_arg_float(va_list *args)
-{
-    return (void*)va_arg(*args, float*);
+    return 1;
 }
 
-static void parse_float(void *arg, const char *str)
+// Like is_strchr, but for a valid multi-byte code point. s is walked
+// one code point at a time, so only a whole code point can match.
+// s has already been checked with is_utf8.
+static bool is_strseq(const char *s, const char *code_point, size_t length)
 {
-    float *float_arg = (float*)arg;
-    *float_arg = strtof(str, NULL);
+    while (*s != '\0')
+    {
+        size_t s_length = utf8_length((unsigned char)*s);
+
+        if (s_length == length && !(memcmp(s, code_point, length)))
+        {
+            return true;
+        }
+
+        s += s_length;
+    }
+
+    return false;
 }
 
-static void *va_arg_short(va_list *args)
+// Only used for the delim, the input is checked while it is read.
+static bool is_utf8(const char *str, size_t length)
 {
-    return (void*)va_arg(*args, short*);
+    const unsigned char *s = (const unsigned char*)str;
+    size_t i = 0;
+
+    while (i < length)
+    {
+        size_t code_point = (s[i] < 0x80) ? 1 : code_point_length(&s[i], length - i);
+
+        if (code_point == 0)
+        {
+            return false;
+        }
+
+        i += code_point;
+    }
+
+    return true;
 }
 
-static void parse_short(void *arg, const char *str)
+// Returns the length of the valid code point at s, or 0 if it is invalid.
+// Overlong forms, surrogates, and anything above U+10FFFF are invalid.
+static size_t code_point_length(const unsigned char *s, size_t length)
 {
-    long number = strtol(str, NULL, 10);
-    short *short_arg = (short*)arg;
+    size_t expected = utf8_length(s[0]);
 
-    if (number < SHRT_MIN)
+    if (expected == 1 || expected > length)
     {
-        *short_arg = SHRT_MIN;
+        return 0;
     }
-    else if (number > SHRT_MAX)
+
+    unsigned char min = 0x80;
+    unsigned char max = 0xBF;
+
+    switch (s[0])
     {
-        *short_arg = SHRT_MAX;
+        case 0xE0:
+            min = 0xA0;
+            break;
+        case 0xED:
+            max = 0x9F;
+            break;
+        case 0xF0:
+            min = 0x90;
+            break;
+        case 0xF4:
+            max = 0x8F;
+            break;
+        default:
+            break;
     }
-    else
+
+    if (s[1] < min || s[1] > max)
     {
-        *short_arg = (short)number;
+        return 0;
     }
-}
 
-static void *va_arg_ushort(va_list *args)
-{
-    return (void*)va_arg(*args, unsigned short*);
+    for (size_t i = 2; i < expected; i++)
+    {
+        if (s[i] < 0x80 || s[i] > 0xBF)
+        {
+            return 0;
+        }
+    }
+
+    return expected;
 }
 
-static void parse_ushort(void *arg, const char *str)
+// Returns the type of every column in format, or NULL
+// if a specifier is not supported.
+static const ColumnType **parse_columns(const char *format, size_t *columns)
 {
-    long number = strtol(str, NULL, 10);
-    unsigned short *ushort_arg = (unsigned short*)arg;
+    char *format_alloc = str_alloc(format);
+    const ColumnType **types = malloc(sizeof(ColumnType*) * (strlen(format) + 1));
 
-    if (number > USHRT_MAX || number <= USHRT_MIN)
+    if (format_alloc == NULL || types == NULL)
     {
-        *ushort_arg = USHRT_MAX;
+        free(format_alloc);
+        free(types);
+        return NULL;
     }
-    else
+
+    char *format_copy = format_alloc;
+    char *specifier = strsep_chars(&format_copy, "%");
+    const size_t TYPES_SIZE = sizeof(COLUMN_TYPES) / sizeof(COLUMN_TYPES[0]);
+
+    *columns = 0;
+
+    while (format_copy != NULL)
     {
-        *ushort_arg = (unsigned short)number;
+        specifier = strsep_chars(&format_copy, "%");
+        types[*columns] = NULL;
+
+        for (size_t i = 0; i < TYPES_SIZE; i++)
+        {
+            if (!(strncmp(specifier, COLUMN_TYPES[i].specifier, MAX_FORMAT)))
+            {
+                types[*columns] = &COLUMN_TYPES[i];
+                break;
+            }
+        }
+
+        if (types[*columns] == NULL)
+        {
+            free(format_alloc);
+            free(types);
+            return NULL;
+        }
+
+        (*columns)++;
     }
-}
 
-static void *va_arg_long(va_list *args)
-{
-    return (void*)va_arg(*args, long*);
-}
+    free(format_alloc);
 
-static void parse_long(void *arg, const char *str)
-{
-    long *long_arg = (long*)arg;
-    *long_arg = strtol(str, NULL, 10);
-}
+    if (*columns == 0)
+    {
+        free(types);
+        return NULL;
+    }
 
-static void *va_arg_double(va_list *args)
-{
-    return (void*)va_arg(*args, double*);
+    return types;
 }
 
-static void parse_double(void *arg, const char *str)
+static char *cache_path(const char *path, const char *format)
 {
-    double *double_arg = (double*)arg;
-    *double_arg = strtod(str, NULL);
-}
+    size_t size = strlen(path) + sizeof(CACHE_SUFFIX) + 17;
+    char *cache = malloc(size);
 
-static void *va_arg_ulong(va_list *args)
-{
-    return (void*)va_arg(*args, unsigned long*);
-}
+    if (cache != NULL)
+    {
+        snprintf(cache, size, "%s.%016llx" CACHE_SUFFIX, path,
+                 (unsigned long long)checksum(format, strlen(format)));
+    }
 
-static void parse_ulong(void *arg, const char *str)
-{
-    unsigned long *ulong_arg = (unsigned long*)arg;
-    *ulong_arg = strtoul(str, NULL, 10);
+    return cache;
 }
 
-static void *va_arg_uint(va_list *args)
+// Maps the cache and points the table's columns into it. Anything that
+// does not match the source file, the format, or the checksum means the
+// cache is stale or corrupt, and the caller parses the text instead.
+static bool load_cache(const char *path, const struct stat *source,
+                       const char *format, const ColumnType **types,
+                       size_t columns, PromptTable *table)
 {
-    return (void*)va_arg(*args, unsigned int*);
-}
+    int fd = open(path, O_RDONLY);
+    struct stat cache;
 
-static void parse_uint(void *arg, const char *str)
-{
-    long number = strtol(str, NULL, 10);
-    unsigned int *uint_arg = (unsigned int*)arg;
+    if (fd == -1)
+    {
+        return false;
+    }
 
-    if (number > UINT32_MAX || number <= UINT32_MIN)
+    if (fstat(fd, &cache) == -1 || (size_t)cache.st_size < sizeof(CacheHeader))
     {
-        *uint_arg = UINT32_MAX;
+        close(fd);
+        return false;
     }
-    else
+
+    size_t size = (size_t)cache.st_size;
+    // The columns are writable, like the ones parsed from the text.
+    // The mapping is private, so a write only copies the page
+    // and never reaches the cache.
+    unsigned char *mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED)
     {
-        *uint_arg = (unsigned int)number;
+        return false;
     }
-}
 
-static void parse_str(ArgumentType *arg_type, va_list *args)
-{
-    char *input = va_arg(*args, char*);
-    const size_t BUFFER_SIZE = va_arg(*args, size_t);
+    CacheHeader header;
+    memcpy(&header, mapping, sizeof(CacheHeader));
+
+    size_t format_size = strlen(format);
+    size_t expected = sizeof(CacheHeader) + CACHE_PADDED(format_size);
+    bool valid = !(memcmp(header.magic, CACHE_MAGIC, CACHE_MAGIC_SIZE))
+                 && header.source_dev == (uint64_t)source->st_dev
+                 && header.source_ino == (uint64_t)source->st_ino
+                 && header.source_size == (uint64_t)source->st_size
+                 && header.source_mtime == (int64_t)source->st_mtime
+                 && header.source_mtime_nsec == (int64_t)MTIME_NSEC(*source)
+                 && header.columns == columns
+                 && header.format_size == format_size
+                 && expected <= size
+                 && !(memcmp(&mapping[sizeof(CacheHeader)], format, format_size));
+
+    // Checking rows against the size first keeps the
+    // column sizes below from wrapping around.
+    for (size_t i = 0; valid && i < columns; i++)
+    {
+        valid = header.rows <= size / types[i]->size
+                && expected <= size - CACHE_PADDED(header.rows * types[i]->size);
+        expected += valid ? CACHE_PADDED(header.rows * types[i]->size) : 0;
+    }
 
-    if (BUFFER_SIZE == 0)
+    valid = valid && expected == size
+            && header.checksum == checksum(&mapping[sizeof(CacheHeader)],
+                                           size - sizeof(CacheHeader));
+
+    table->data = valid ? malloc(sizeof(void*) * columns) : NULL;
+
+    if (table->data == NULL)
     {
-        arg_type->status = READ_FAILURE;
-        return;
+        munmap(mapping, size);
+        return false;
     }
 
-    parse_prompt(input, BUFFER_SIZE, arg_type, "\n", true, stdin);
+    size_t offset = sizeof(CacheHeader) + CACHE_PADDED(format_size);
 
-    if (arg_type->status == READ_EOF)
+    for (size_t i = 0; i < columns; i++)
     {
-        return;
+        table->data[i] = &mapping[offset];
+        offset += CACHE_PADDED((size_t)header.rows * types[i]->size);
     }
 
-    arg_type->status = READ_SUCCESS;
+    table->rows = (size_t)header.rows;
+    table->columns = columns;
+    table->mapping = mapping;
+    table->mapping_size = size;
+
+    return true;
 }
 
-// This function was inspired by this video:
-// https://youtu.be/NsB6dqvVu7Y?t=231
-static void parse_prompt(char *input, const size_t BUFFER_SIZE, ArgumentType *arg_type,
-                         const char *delim, bool matched_delim, FILE *stream)
+// Every line is a row, and fields are separated by spaces or tabs.
+// Blank lines are skipped, and missing fields are 0.
+static bool parse_table(const char *path, const ColumnType **types,
+                        size_t columns, PromptTable *table)
 {
-    int ch = getc(stream);
-    size_t i = 0;
-    const size_t LAST_INDEX = BUFFER_SIZE - 1;
+    FILE *stream = fopen(path, "r");
+    char *line = NULL;
+    size_t line_capacity = 0;
+    size_t capacity = 0;
 
-    // If you are only using the prompt function,
-    // we do not want you to read any newlines or spaces first.
-    if (arg_type)
+    table->columns = columns;
+    table->data = calloc(columns, sizeof(void*));
+
+    if (stream == NULL || table->data == NULL)
     {
-        while (ch == '\n' || ch == ' ')
+        if (stream != NULL)
         {
-            ch = getc(stream);
+            fclose(stream);
         }
+
+        prompt_table_free(table);
+        return false;
     }
 
-    while (ch != EOF && !(is_multiple_specifiers(arg_type, ch)))
+    while (getline(&line, &line_capacity, stream) != -1)
     {
-        // I can't remember why is_strchr has to go first.
-        // I think it caused some bug, but I don't remember
-        // what bug or how to replicate it.
-        if (is_strchr(delim, ch) == matched_delim
-            || is_space(arg_type, ch)
-            || is_non_numeric(arg_type, ch))
+        char *save = NULL;
+        char *field = strtok_r(line, " \t\r\n", &save);
+
+        if (field == NULL)
         {
-            // Clear only the input buffer. We do not want 
-            // to clear any file buffers.
-            if (stream == stdin)
+            continue;
+        }
+
+        if (table->rows == capacity)
+        {
+            capacity = (capacity == 0) ? 64 : capacity * 2;
+
+            for (size_t i = 0; i < columns; i++)
             {
-                // Clearing the buffer.
-                while (ch != '\n' && ch != EOF)
+                void *column = realloc(table->data[i], capacity * types[i]->size);
+
+                if (column == NULL)
                 {
-                    ch = getc(stream);
+                    free(line);
+                    fclose(stream);
+                    prompt_table_free(table);
+                    return false;
                 }
+
+                table->data[i] = column;
             }
+        }
 
-            break;
+        for (size_t i = 0; i < columns; i++)
+        {
+            char *value = (char*)table->data[i] + table->rows * types[i]->size;
+
+            if (field == NULL)
+            {
+                memset(value, 0, types[i]->size);
+            }
+            else
+            {
+                types[i]->set(value, field);
+                field = strtok_r(NULL, " \t\r\n", &save);
+            }
         }
 
-        // Even if we reach the BUFFER_SIZE we should
-        // not clear the input buffer as there could be
-        // multiple specifiers.
-        if (i != LAST_INDEX)
+        table->rows++;
+    }
+
+    // getline returns -1 on an error too, and a table cut short
+    // by an error must not be returned, let alone cached.
+    bool failed = ferror(stream);
+
+    free(line);
+    fclose(stream);
+
+    if (failed)
+    {
+        prompt_table_free(table);
+        return false;
+    }
+
+    return true;
+}
+
+// Writes to a temporary file first and renames it, so a reader never
+// sees a half written cache. Failing to write the cache is not an error.
+static void write_cache(const char *path, const struct stat *source,
+                        const char *format, const ColumnType **types,
+                        const PromptTable *table)
+{
+    static const char PADDING[CACHE_ALIGN] = {0};
+    size_t temp_size = strlen(path) + 8;
+    char *temp = malloc(temp_size);
+
+    if (temp == NULL)
+    {
+        return;
+    }
+
+    snprintf(temp, temp_size, "%s.XXXXXX", path);
+
+    int fd = mkstemp(temp);
+    FILE *cache = (fd == -1) ? NULL : fdopen(fd, "wb");
+
+    if (cache == NULL)
+    {
+        if (fd != -1)
         {
-            input[i] = (char)ch;
-            i++;
+            close(fd);
+            unlink(temp);
         }
 
-        ch = getc(stream);
+        free(temp);
+        return;
     }
 
-    input[i] = '\0';
+    CacheHeader header;
+    memset(&header, 0, sizeof(CacheHeader));
+    memcpy(header.magic, CACHE_MAGIC, CACHE_MAGIC_SIZE);
+    header.source_dev = (uint64_t)source->st_dev;
+    header.source_ino = (uint64_t)source->st_ino;
+    header.source_size = (uint64_t)source->st_size;
+    header.source_mtime = (int64_t)source->st_mtime;
+    header.source_mtime_nsec = (int64_t)MTIME_NSEC(*source);
+    header.rows = table->rows;
+    header.columns = table->columns;
+    header.format_size = strlen(format);
+
+    size_t format_size = (size_t)header.format_size;
+    size_t size = sizeof(CacheHeader) + CACHE_PADDED(format_size);
+    bool written = fwrite(&header, sizeof(CacheHeader), 1, cache) == 1
+                   && fwrite(format, 1, format_size, cache) == format_size
+                   && fwrite(PADDING, 1, CACHE_PADDED(format_size) - format_size, cache)
+                      == CACHE_PADDED(format_size) - format_size;
+
+    for (size_t i = 0; written && i < table->columns; i++)
+    {
+        size_t column_size = table->rows * types[i]->size;
+        size_t padding = CACHE_PADDED(column_size) - column_size;
 
-    // It should be a failure if the first index is 0.
-    if (arg_type && input[0] == '\0')
+        written = fwrite(table->data[i], 1, column_size, cache) == column_size
+                  && fwrite(PADDING, 1, padding, cache) == padding;
+        size += column_size + padding;
+    }
+
+    // The checksum is taken over the file as written, the
+    // same way load_cache takes it, and then goes in the header.
+    unsigned char *mapping = MAP_FAILED;
+
+    if (written && fflush(cache) == 0)
     {
-        arg_type->status = READ_FAILURE;
+        mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
     }
 
-    // It could be the eof.
-    if (arg_type && ch == EOF)
+    if (mapping != MAP_FAILED)
     {
-        arg_type->status = READ_EOF;
+        header.checksum = checksum(&mapping[sizeof(CacheHeader)],
+                                   size - sizeof(CacheHeader));
+        munmap(mapping, size);
     }
-}
 
-static bool is_multiple_specifiers(ArgumentType *arg_type, int ch)
-{
-    return (arg_type && (arg_type->options & MULTIPLE_SPECIFIERS) && ch == ' ');
-}
+    written = written && mapping != MAP_FAILED && fseek(cache, 0, SEEK_SET) == 0
+              && fwrite(&header, sizeof(CacheHeader), 1, cache) == 1;
+    // mkstemp makes the file readable only by us, so give it the
+    // mode any other new file gets, for everyone sharing the text.
+    mode_t mask = umask(0);
+    umask(mask);
 
-static bool is_strchr(const char *s, int ch)
-{
-    return (bool)(strchr(s, ch));
+    written = written && fchmod(fileno(cache), 0666 & ~mask) == 0;
+    written = (fclose(cache) == 0) && written;
+
+    if (!written || rename(temp, path) == -1)
+    {
+        unlink(temp);
+    }
+
+    free(temp);
 }
 
-static bool is_space(ArgumentType *arg_type, int ch)
+static bool is_same_file(const struct stat *a, const struct stat *b)
 {
-    return (arg_type && (arg_type->options & STOP_AT_SPACE) && ch == ' ');
+    return a->st_dev == b->st_dev && a->st_ino == b->st_ino
+           && a->st_size == b->st_size && a->st_mtime == b->st_mtime
+           && MTIME_NSEC(*a) == MTIME_NSEC(*b);
 }
 
-static bool is_non_numeric(ArgumentType *arg_type, int ch)
+// FNV-1a, but 8 bytes at a time so checking a large cache stays
+// much cheaper than parsing the text. It also names the cache.
+static uint64_t checksum(const void *data, size_t size)
 {
-    if (arg_type && (arg_type->options & NUMERICS_ONLY)
-        && !((ch >= '0' && ch <= '9') || ch == '.' || ch == '-' ||
-            ch == '+'  || ch == 'e' || ch == 'E'))
+    const unsigned char *bytes = data;
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    size_t i = 0;
+
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
     {
-        arg_type->status = READ_NON_NUMERIC;
-        return true;
+        uint64_t word;
+        memcpy(&word, &bytes[i], sizeof(word));
+
+        hash ^= word;
+        hash *= 0x100000001B3ULL;
     }
 
-    return false;
-}
+    for (; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ULL;
+    }
 
-static size_t calculate_capacity(size_t capacity)
-{
-    return ((capacity >> 3) + (capacity < 9 ? 3 : 6)) + capacity;
+    return hash;
 }
-
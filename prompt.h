@@ -48,6 +48,69 @@ that is NOT a '0' or a '1'.
 printing out your message to the user instead of calling printf
 before you use an input function.
 
+7. prompt_timeout, prompt_gets_timeout, prompt_gets_delim_stream_timeout,
+prompt_getline_timeout, and prompt_getline_delim_stream_timeout
+take a timeout in milliseconds.
+The timeout is a deadline for the whole call, not for each char.
+If the deadline passes before the input is complete, they return
+PROMPT_TIMEOUT. A negative timeout waits forever.
+Whatever was read before the timeout is kept. For prompt_gets_timeout,
+input holds the partial field, so you can resume the read with
+input + strlen(input) and the remaining size. For prompt_getline_timeout,
+*input holds the partial field and you must free it.
+prompt_timeout takes a PromptResume that you zero before the first call.
+On a timeout, resume.read is the number of specifiers already filled,
+and the chars of the one it was reading are kept in resume. Call it again
+with the same resume, format, and arguments to carry on where it stopped.
+The filled specifiers are not touched again, and the message is only
+printed when resume is empty. Once a call does not time out, resume
+is zeroed again so it can be used for the next prompt.
+The stream is only polled when its buffer is empty. On platforms where
+the buffer cannot be inspected (anything but glibc, macOS, and the BSDs),
+a timeout that is not negative is not supported and they return 0.
+
+8. The prompt functions are thread safe. Each call locks its stream
+once with flockfile and reads every char without taking the lock again.
+Functions that print a message lock stdin before printing it,
+so a message and its input are never split by another thread's prompt.
+Threads using different streams never wait on each other.
+Threads sharing a stream take turns, one whole read at a time.
+
+9. prompt_gets_utf8, prompt_gets_delim_utf8, and
+prompt_gets_delim_stream_utf8 treat the input and the delim as UTF-8.
+A delim can be any code point, so "、。\n" works as a delim.
+If the input does not fit, it is cut before the first code point
+that does not fit, never in the middle of one.
+They return PROMPT_INVALID_UTF8 if the input is not valid UTF-8,
+and 0 if the delim is not. Every code point is checked as it is
+read, so the input is never scanned twice. ASCII input is read
+the same way as prompt_gets.
+
+10. prompt_record_start logs every char the prompt functions read
+from a stream into an append only binary file, with timestamps.
+It also logs how many chars were cleared from the input buffer.
+prompt_replay_open turns a log back into a stream that the _stream
+functions can read, either at the original timing or as fast as
+possible. This turns real console sessions into repeatable benchmarks.
+Only one stream can be recorded at a time, and prompt_record_stop
+has to be called before exiting to write the last chars to the log.
+
+11. prompt_table_load reads a text file of numbers into columns,
+one row per line, with fields separated by spaces or tabs.
+format has one specifier per column, like "%d%lf%lf"
+(every specifier but %s works). With use_cache, the first load
+writes the values to a binary file next to the text file, named
+after the format. Later loads map that file and skip the text
+entirely, as long as the text file is the same file (device and
+inode) with the same size and mtime. A stale or corrupt cache is
+ignored and rewritten. A text file modified in the last two seconds
+is not cached, because it could still change without changing
+its mtime.
+Cast table.data[column] to a pointer of the column's type.
+The columns can be written to. A write to a mapped column
+only changes the table, never the cache.
+Free the table with prompt_table_free.
+
 Format specifiers supported by the prompt function:
 Format Specifier | Data Type
 %c  | char
@@ -65,9 +128,7 @@ Format Specifier | Data Type
 #ifndef PROMPT_H
 #define PROMPT_H
 
-#ifdef __clang__
 #include <limits.h>
-#endif
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -75,8 +136,38 @@ Format Specifier | Data Type
 #include <stdlib.h>
 #include <string.h>
 
+// The longest field prompt reads for a number or a char.
+#define PROMPT_MAX_READ             1080
+
+// Where prompt_timeout left off. Zero it before the first call
+// and pass the same one back to resume.
+typedef struct PromptResume
+{
+    int read;
+    size_t length;
+    char field[PROMPT_MAX_READ];
+} PromptResume;
+
+typedef struct PromptTable
+{
+    size_t rows;
+    size_t columns;
+    void **data;
+    void *mapping;
+    size_t mapping_size;
+} PromptTable;
+
+// Returned by the _timeout functions when the deadline passes.
+#define PROMPT_TIMEOUT              (EOF - 1)
+
+// Returned by the _utf8 functions when the input is not valid UTF-8.
+#define PROMPT_INVALID_UTF8         (EOF - 2)
+
 int prompt(const char *message, const char *format, ...);
 
+int prompt_timeout(const char *message, int timeout_ms, PromptResume *resume,
+                   const char *format, ...);
+
 int prompt_gets(const char *message, char *input, const size_t BUFFER_SIZE);
 
 int prompt_gets_delim(const char *message, char *input,
@@ -89,6 +180,23 @@ int prompt_gets_delim_stream(char *input, const size_t BUFFER_SIZE,
                              const char *delim, bool matched_delim,
                              FILE *stream);
 
+int prompt_gets_timeout(const char *message, char *input,
+                        const size_t BUFFER_SIZE, int timeout_ms);
+
+int prompt_gets_delim_stream_timeout(char *input, const size_t BUFFER_SIZE,
+                                     const char *delim, bool matched_delim,
+                                     FILE *stream, int timeout_ms);
+
+int prompt_gets_utf8(const char *message, char *input, const size_t BUFFER_SIZE);
+
+int prompt_gets_delim_utf8(const char *message, char *input,
+                           const size_t BUFFER_SIZE, const char *delim,
+                           bool matched_delim);
+
+int prompt_gets_delim_stream_utf8(char *input, const size_t BUFFER_SIZE,
+                                  const char *delim, bool matched_delim,
+                                  FILE *stream);
+
 int prompt_getline(const char *message, char **input);
 
 int prompt_getline_delim(const char *message, char **input, const char *delim,
@@ -99,4 +207,21 @@ int prompt_getline_stream(char **input, FILE *stream);
 int prompt_getline_delim_stream(char **input, const char *delim,
                                 bool matched_delim, FILE *stream);
 
+int prompt_getline_timeout(const char *message, char **input, int timeout_ms);
+
+int prompt_getline_delim_stream_timeout(char **input, const char *delim,
+                                        bool matched_delim, FILE *stream,
+                                        int timeout_ms);
+
+int prompt_record_start(FILE *stream, const char *path);
+
+void prompt_record_stop(void);
+
+FILE *prompt_replay_open(const char *path, bool original_timing);
+
+int prompt_table_load(const char *path, const char *format, bool use_cache,
+                      PromptTable *table);
+
+void prompt_table_free(PromptTable *table);
+
 #endif /* PROMPT_H */